@@ -0,0 +1,13 @@
+declare name "filterbank_eq";
+declare description "Third-octave graphic equalizer, 31 bands";
+
+import("stdfaust.lib");
+
+nbands = 31;
+band(i) = fi.peak_eq_cq(gain, freq, 4.3)
+with {
+    freq = 20 * pow(2, i / 3);
+    gain = vslider("[%2i] band %i [unit:dB]", 0, -12, 12, 0.1) : si.smoo;
+};
+
+process = seq(i, nbands, band(i));
@@ -0,0 +1,11 @@
+declare name "filterbank_vocoder";
+declare description "Channel vocoder, 32 bands of bandpass filters and envelope followers";
+
+import("stdfaust.lib");
+
+nbands = 32;
+att = hslider("[0] attack [unit:ms]", 5, 0.1, 100, 0.1) * 0.001;
+rel = hslider("[1] release [unit:ms]", 20, 0.1, 100, 0.1) * 0.001;
+bw = hslider("[2] bandwidth", 0.5, 0.1, 2, 0.01);
+
+process = ve.vocoder(nbands, att, rel, bw);
@@ -0,0 +1,12 @@
+declare name "physical_djembe";
+declare description "Modal djembe model from the physical modeling library";
+
+import("stdfaust.lib");
+
+freq = hslider("[0] frequency [unit:Hz]", 60, 40, 200, 1);
+position = hslider("[1] strike position", 0.3, 0, 1, 0.01);
+sharpness = hslider("[2] strike sharpness", 0.5, 0.01, 5, 0.01);
+gain = hslider("[3] gain", 1, 0, 1, 0.01);
+gate = button("[4] strike");
+
+process = pm.djembe(freq, position, sharpness, gain, gate) <: _, _;
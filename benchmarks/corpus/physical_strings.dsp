@@ -0,0 +1,19 @@
+declare name "physical_strings";
+declare description "Bank of 12 Karplus-Strong strings with fractional delays";
+
+import("stdfaust.lib");
+
+nstrings = 12;
+damping = hslider("[0] damping", 0.3, 0, 1, 0.01) : si.smoo;
+feedback = hslider("[1] feedback", 0.996, 0.9, 0.9999, 0.0001);
+gate = button("[2] pluck");
+
+string(i) = (excitation + _ : de.fdelay4(4096, period) : loss) ~ _
+with {
+    freq = 55 * pow(2, i * 5 / 12);
+    period = ma.SR / freq - 2;
+    excitation = no.noise * en.ar(0.001, 0.01, gate);
+    loss = _ <: (_ + _') / 2 : *(feedback) : fi.lowpass(1, 20000 - damping * 18000);
+};
+
+process = par(i, nstrings, string(i)) :> _ <: _, _;
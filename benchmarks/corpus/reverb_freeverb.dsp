@@ -0,0 +1,10 @@
+declare name "reverb_freeverb";
+declare description "Freeverb, 8 comb and 4 allpass filters per channel";
+
+import("stdfaust.lib");
+
+fb1 = hslider("[0] room size", 0.5, 0, 1, 0.01) * 0.28 + 0.7;
+damp = hslider("[1] damping", 0.5, 0, 1, 0.01) * 0.4;
+spread = 23;
+
+process = re.stereo_freeverb(fb1, 0.5, damp, spread);
@@ -0,0 +1,12 @@
+declare name "reverb_zita";
+declare description "Zita-rev1 stereo reverb";
+
+import("stdfaust.lib");
+
+rdel = hslider("[0] pre-delay [unit:ms]", 60, 20, 100, 1);
+f1 = hslider("[1] crossover [unit:Hz]", 200, 50, 1000, 1);
+t60dc = hslider("[2] low RT60 [unit:s]", 3, 1, 8, 0.1);
+t60m = hslider("[3] mid RT60 [unit:s]", 2, 1, 8, 0.1);
+f2 = hslider("[4] HF damping [unit:Hz]", 6000, 1500, 23520, 1);
+
+process = re.zita_rev1_stereo(rdel, f1, f2, t60dc, t60m, 48000);
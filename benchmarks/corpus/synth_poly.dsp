@@ -0,0 +1,18 @@
+declare name "synth_poly";
+declare description "16-voice subtractive synthesizer, two detuned sawtooths and a resonant lowpass per voice";
+
+import("stdfaust.lib");
+
+nvoices = 16;
+cutoff = hslider("[0] cutoff [unit:Hz]", 2000, 50, 10000, 1) : si.smoo;
+q = hslider("[1] resonance", 2, 0.7, 10, 0.01);
+detune = hslider("[2] detune", 0.005, 0, 0.05, 0.001);
+
+voice(i) = (os.sawtooth(freq) + os.sawtooth(freq * (1 + detune))) * env * 0.1 : fi.resonlp(cutoff * (1 + env), q, 1)
+with {
+    freq = hslider("v:voices/[%2i] note %i", 48 + i, 0, 127, 1) : ba.midikey2hz;
+    gate = checkbox("v:voices/[%2i] gate %i");
+    env = en.adsr(0.01, 0.1, 0.7, 0.3, gate);
+};
+
+process = par(i, nvoices, voice(i)) :> _ <: _, _;
@@ -0,0 +1,376 @@
+// Microbenchmarks of the host-side code of jest, excluding the cost of DSP.
+//
+// The reported time is the median of several repetitions, each one long
+// enough to amortize the timer, so the results of two commits can be
+// compared directly.
+
+#include "jest_processor.h"
+#include "jest_parameters.h"
+#include "jest_dsp.h"
+#include "faust/MyQTUI.h"
+#include "utility/logs.h"
+#include <faust/dsp/dsp.h>
+#include <faust/gui/UI.h>
+#include <faust/gui/meta.h>
+#include <faust/gui/GUI.h>
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QWidget>
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace jest;
+
+// a DSP which does no work, with any number of ports and controls
+class BenchDsp final : public dsp {
+public:
+    BenchDsp(int numInputs, int numOutputs, int numControls)
+        : _numInputs(numInputs), _numOutputs(numOutputs), _controls(numControls)
+    {
+    }
+
+    void metadata(Meta *m) override { m->declare("name", "bench"); }
+    int getNumInputs() override { return _numInputs; }
+    int getNumOutputs() override { return _numOutputs; }
+    void instanceConstants(int sampleRate) override { _sampleRate = sampleRate; }
+    void instanceResetUserInterface() override { std::fill(_controls.begin(), _controls.end(), 0); }
+    void instanceClear() override {}
+    void init(int sampleRate) override { instanceInit(sampleRate); }
+    void instanceInit(int sampleRate) override
+    {
+        instanceConstants(sampleRate);
+        instanceResetUserInterface();
+        instanceClear();
+    }
+    BenchDsp *clone() override { return new BenchDsp(_numInputs, _numOutputs, (int)_controls.size()); }
+    int getSampleRate() override { return _sampleRate; }
+
+    void buildUserInterface(UI *ui) override
+    {
+        enum { kControlsPerBox = 32 };
+        ui->openVerticalBox("bench");
+        for (size_t i = 0, n = _controls.size(); i < n; ++i) {
+            if (i % kControlsPerBox == 0)
+                ui->openHorizontalBox(_labels.get("group", i / kControlsPerBox));
+            ui->addHorizontalSlider(_labels.get("control", i), &_controls[i], 0, 0, 1, 0.001);
+            if (i % kControlsPerBox == kControlsPerBox - 1 || i + 1 == n)
+                ui->closeBox();
+        }
+        ui->closeBox();
+    }
+
+    void compute(int, FAUSTFLOAT **, FAUSTFLOAT **) override {}
+
+    std::vector<FAUSTFLOAT> &controls() noexcept { return _controls; }
+
+private:
+    // labels must outlive the UI
+    struct Labels {
+        std::vector<std::unique_ptr<std::string>> storage;
+        const char *get(const char *prefix, size_t index)
+        {
+            storage.emplace_back(new std::string(prefix + std::to_string(index)));
+            return storage.back()->c_str();
+        }
+    };
+
+    int _numInputs = 0;
+    int _numOutputs = 0;
+    int _sampleRate = 0;
+    std::vector<FAUSTFLOAT> _controls;
+    Labels _labels;
+};
+
+///
+using BenchmarkBody = std::function<void(uint64_t iterations)>;
+
+struct Benchmark {
+    std::string name;
+    std::function<BenchmarkBody()> setup;
+};
+
+static uint64_t monotonic_ns() noexcept
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static double runTimed(const BenchmarkBody &body, uint64_t iterations)
+{
+    uint64_t start = monotonic_ns();
+    body(iterations);
+    return (double)(monotonic_ns() - start);
+}
+
+struct BenchmarkResult {
+    uint64_t iterations = 0;
+    double median = 0;
+    double min = 0;
+};
+
+static BenchmarkResult measure(const BenchmarkBody &body, double minTime, int repetitions)
+{
+    uint64_t iterations = 1;
+    for (;;) {
+        double elapsed = runTimed(body, iterations);
+        if (elapsed >= minTime * 1e9 || iterations >= (uint64_t)1 << 40)
+            break;
+        double factor = (elapsed > 0) ? (minTime * 1e9 * 1.2 / elapsed) : 10;
+        iterations = (uint64_t)(iterations * std::min(10.0, std::max(1.5, factor)));
+    }
+
+    std::vector<double> times((size_t)repetitions);
+    for (double &time : times)
+        time = runTimed(body, iterations) / iterations;
+    std::sort(times.begin(), times.end());
+
+    BenchmarkResult result;
+    result.iterations = iterations;
+    result.median = times[times.size() / 2];
+    result.min = times.front();
+    return result;
+}
+
+///
+enum { kBenchBlockSize = 256 };
+
+static void addProcessBenchmarks(std::vector<Benchmark> &benchmarks)
+{
+    for (int ports : {0, 2, 8, 32, 128}) {
+        benchmarks.push_back({"process/ports:" + std::to_string(ports), [ports]() -> BenchmarkBody {
+            auto dsp = std::make_shared<BenchDsp>(ports, ports, 0);
+            auto processor = std::make_shared<Processor>();
+            auto buffers = std::make_shared<std::vector<std::vector<float>>>(2 * ports, std::vector<float>(kBenchBlockSize));
+            auto pointers = std::make_shared<std::vector<float *>>();
+            for (std::vector<float> &buffer : *buffers)
+                pointers->push_back(buffer.data());
+            dsp->init(48000);
+            processor->setSampleRate(48000);
+            processor->setDsp(dsp.get());
+            return [dsp, processor, buffers, pointers, ports](uint64_t iterations) {
+                float **inputs = pointers->data();
+                float **outputs = inputs + ports;
+                for (uint64_t i = 0; i < iterations; ++i)
+                    processor->process(inputs, outputs, ports, kBenchBlockSize);
+            };
+        }});
+    }
+
+    benchmarks.push_back({"process/no-dsp/ports:2", []() -> BenchmarkBody {
+        auto processor = std::make_shared<Processor>();
+        auto buffers = std::make_shared<std::vector<std::vector<float>>>(2, std::vector<float>(kBenchBlockSize));
+        processor->setSampleRate(48000);
+        return [processor, buffers](uint64_t iterations) {
+            float *outputs[2] = {(*buffers)[0].data(), (*buffers)[1].data()};
+            for (uint64_t i = 0; i < iterations; ++i)
+                processor->process(nullptr, outputs, 2, kBenchBlockSize);
+        };
+    }});
+}
+
+static void addParameterBenchmarks(std::vector<Benchmark> &benchmarks)
+{
+    for (int controls : {16, 256, 4096}) {
+        benchmarks.push_back({"collectDspParameters/controls:" + std::to_string(controls), [controls]() -> BenchmarkBody {
+            auto dsp = std::make_shared<BenchDsp>(2, 2, controls);
+            return [dsp](uint64_t iterations) {
+                for (uint64_t i = 0; i < iterations; ++i) {
+                    std::vector<Parameter> inputs;
+                    collectDspParameters(dsp.get(), &inputs, nullptr);
+                }
+            };
+        }});
+    }
+
+    for (int controls : {256, 4096}) {
+        benchmarks.push_back({"setControls/controls:" + std::to_string(controls), [controls]() -> BenchmarkBody {
+            auto dsp = std::make_shared<BenchDsp>(2, 2, controls);
+            auto processor = std::make_shared<Processor>();
+            auto values = std::make_shared<std::vector<float>>(controls, 0.5f);
+            processor->setDsp(dsp.get());
+            return [dsp, processor, values](uint64_t iterations) {
+                for (uint64_t i = 0; i < iterations; ++i)
+                    processor->setControls(values->data(), values->size());
+            };
+        }});
+    }
+}
+
+// silences the log output while a benchmark is running
+class StderrSilencer {
+public:
+    StderrSilencer()
+    {
+        Log::flush();
+        fflush(stderr);
+        _saved = dup(STDERR_FILENO);
+        int null = open("/dev/null", O_WRONLY);
+        dup2(null, STDERR_FILENO);
+        close(null);
+    }
+    ~StderrSilencer()
+    {
+        Log::flush();
+        fflush(stderr);
+        dup2(_saved, STDERR_FILENO);
+        close(_saved);
+    }
+
+private:
+    int _saved = -1;
+};
+
+static void addLogBenchmarks(std::vector<Benchmark> &benchmarks)
+{
+    benchmarks.push_back({"log/blocking", []() -> BenchmarkBody {
+        return [](uint64_t iterations) {
+            StderrSilencer silencer;
+            for (uint64_t i = 0; i < iterations; ++i)
+                Log::i("Message %llu: %s", (unsigned long long)i, "benchmark");
+        };
+    }});
+    benchmarks.push_back({"log/real-time", []() -> BenchmarkBody {
+        return [](uint64_t iterations) {
+            StderrSilencer silencer;
+            for (uint64_t i = 0; i < iterations; ++i)
+                RTLog::i("Message %llu: %s", (unsigned long long)i, "benchmark");
+        };
+    }});
+}
+
+static void addSettingsBenchmarks(std::vector<Benchmark> &benchmarks)
+{
+    benchmarks.push_back({"compileSettingsToJson", []() -> BenchmarkBody {
+        return [](uint64_t iterations) {
+            CompileSettings settings;
+            for (uint64_t i = 0; i < iterations; ++i) {
+                settings.cxxOpt = (int)(i & 3);
+                QJsonDocument document = compileSettingsToJson(settings);
+                (void)document;
+            }
+        };
+    }});
+    benchmarks.push_back({"compileSettingsFromJson", []() -> BenchmarkBody {
+        auto document = std::make_shared<QJsonDocument>(compileSettingsToJson(CompileSettings()));
+        return [document](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; ++i) {
+                CompileSettings settings = compileSettingsFromJson(*document);
+                (void)settings;
+            }
+        };
+    }});
+}
+
+static void addGuiBenchmarks(std::vector<Benchmark> &benchmarks)
+{
+    for (int controls : {1000, 5000}) {
+        for (bool changed : {false, true}) {
+            std::string name = "updateAllGuis/controls:" + std::to_string(controls) + (changed ? "/changed" : "/unchanged");
+            benchmarks.push_back({name, [controls, changed]() -> BenchmarkBody {
+                auto dsp = std::make_shared<BenchDsp>(2, 2, controls);
+                std::shared_ptr<GUI> gui(QTUI_create(), &QTUI_delete);
+                dsp->buildUserInterface(gui.get());
+                return [dsp, gui, changed](uint64_t iterations) {
+                    std::vector<FAUSTFLOAT> &zones = dsp->controls();
+                    for (uint64_t i = 0; i < iterations; ++i) {
+                        if (changed) {
+                            FAUSTFLOAT value = (i & 1) ? 0.25f : 0.75f;
+                            std::fill(zones.begin(), zones.end(), value);
+                        }
+                        GUI::updateAllGuis();
+                    }
+                };
+            }});
+        }
+    }
+}
+
+///
+int main(int argc, char *argv[])
+{
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+
+    QApplication app(argc, argv);
+    app.setApplicationName("jest_bench");
+
+    QCommandLineParser clp;
+    clp.setApplicationDescription("Microbenchmarks of jest");
+    clp.addHelpOption();
+
+    const QCommandLineOption filterOption("filter", "Run the benchmarks whose name contains <text>.", "text");
+    clp.addOption(filterOption);
+    const QCommandLineOption minTimeOption("min-time", "Minimum duration of a repetition.", "seconds", "0.2");
+    clp.addOption(minTimeOption);
+    const QCommandLineOption repetitionsOption("repetitions", "Number of repetitions.", "count", "5");
+    clp.addOption(repetitionsOption);
+    const QCommandLineOption jsonOption("json", "Write the results as JSON.");
+    clp.addOption(jsonOption);
+    const QCommandLineOption listOption("list", "List the benchmarks.");
+    clp.addOption(listOption);
+
+    clp.process(app);
+
+    const QString filter = clp.value(filterOption);
+    double minTime = std::max(0.001, clp.value(minTimeOption).toDouble());
+    int repetitions = std::max(1, clp.value(repetitionsOption).toInt());
+    bool json = clp.isSet(jsonOption);
+
+    std::vector<Benchmark> benchmarks;
+    addProcessBenchmarks(benchmarks);
+    addParameterBenchmarks(benchmarks);
+    addLogBenchmarks(benchmarks);
+    addSettingsBenchmarks(benchmarks);
+    addGuiBenchmarks(benchmarks);
+
+    QJsonArray results;
+    for (const Benchmark &benchmark : benchmarks) {
+        const QString name = QString::fromStdString(benchmark.name);
+        if (!filter.isEmpty() && !name.contains(filter))
+            continue;
+        if (clp.isSet(listOption)) {
+            printf("%s\n", benchmark.name.c_str());
+            continue;
+        }
+
+        BenchmarkBody body = benchmark.setup();
+        BenchmarkResult result = measure(body, minTime, repetitions);
+        body = nullptr;
+
+        if (json) {
+            QJsonObject entry;
+            entry["name"] = name;
+            entry["iterations"] = (double)result.iterations;
+            entry["ns-per-op"] = result.median;
+            entry["ns-per-op-min"] = result.min;
+            results.push_back(entry);
+        }
+        else {
+            printf("%-48s %14.1f ns/op %14.1f min %12llu iterations\n",
+                   benchmark.name.c_str(), result.median, result.min,
+                   (unsigned long long)result.iterations);
+            fflush(stdout);
+        }
+    }
+
+    if (json && !clp.isSet(listOption)) {
+        QJsonObject root;
+        root["benchmarks"] = results;
+        QByteArray data = QJsonDocument(root).toJson(QJsonDocument::Indented);
+        fwrite(data.constData(), 1, data.size(), stdout);
+    }
+
+    Log::flush();
+    return 0;
+}
@@ -0,0 +1,170 @@
+#!/usr/bin/env python3
+#
+# Measures the latency from the modification of a DSP file until the first
+# block processed by the new module, with jest running against the null
+# audio backend.
+#
+#   reload_latency.py --jest build/jest --output latency.json
+#
+# The phases of each reload are read from the metrics socket; the detection
+# phase starts at the write of the file.
+
+import argparse
+import json
+import os
+import shutil
+import signal
+import socket
+import statistics
+import subprocess
+import sys
+import tempfile
+import time
+
+corpus_dir = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'corpus')
+
+program_template = '''import("stdfaust.lib");
+gain = %(constant)s;
+process = no.noise * gain : seq(i, %(stages)d, fi.lowpass(2, 1000 + i * 100)) <: _, _;
+%(comments)s'''
+
+phases = ['detect', 'queue', 'faust', 'compile', 'link', 'load', 'swap', 'gui', 'first-block', 'total']
+
+
+class Program:
+    def __init__(self, path):
+        self.path = path
+        self.constant = 0.5
+        self.stages = 4
+        self.comments = []
+
+    def edit(self, kind):
+        if kind == 'comment':
+            self.comments.append('// edit %d' % len(self.comments))
+        elif kind == 'constant':
+            self.constant = 0.75 if self.constant == 0.5 else 0.5
+        elif kind == 'structure':
+            self.stages = 5 if self.stages == 4 else 4
+        self.write()
+
+    def write(self):
+        text = program_template % {
+            'constant': repr(self.constant),
+            'stages': self.stages,
+            'comments': ''.join(line + '\n' for line in self.comments),
+        }
+        with open(self.path, 'w') as f:
+            f.write(text)
+
+
+def read_metrics(path):
+    sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    try:
+        sock.connect(path)
+        sock.sendall(b'/metrics.json\n')
+        data = b''
+        while True:
+            chunk = sock.recv(65536)
+            if not chunk:
+                break
+            data += chunk
+    finally:
+        sock.close()
+    return json.loads(data.decode())
+
+
+def wait_for_reload(metrics_path, sequence, timeout):
+    deadline = time.monotonic() + timeout
+    while time.monotonic() < deadline:
+        try:
+            reload = read_metrics(metrics_path)['last-reload']
+            if reload['sequence'] > sequence and reload['first-block'] > 0:
+                return reload
+        except (OSError, ValueError, KeyError):
+            pass
+        time.sleep(0.005)
+    raise RuntimeError('no reload within %g seconds' % timeout)
+
+
+def measure_configuration(args, settings, work_dir):
+    program = Program(os.path.join(work_dir, 'latency.dsp'))
+    program.write()
+    metrics_path = os.path.join(work_dir, 'metrics.sock')
+
+    env = dict(os.environ)
+    env['QT_QPA_PLATFORM'] = 'offscreen'
+    env['JEST_BACKEND'] = 'null'
+    # the edits go back and forth, later repeats would find their builds cached
+    env['JEST_SHARED_CACHE'] = 'off'
+    # and the prebuilds of neighbour settings would compete with the next edit
+    env['JEST_SPECULATIVE_BUILDS'] = '0'
+    env.pop('NSM_URL', None)
+    cmd = [args.jest, '--metrics', metrics_path, '--settings', json.dumps(settings), program.path]
+    proc = subprocess.Popen(cmd, env=env, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+
+    try:
+        reload = wait_for_reload(metrics_path, 0, args.timeout)
+        sequence = reload['sequence']
+
+        samples = {}
+        for kind in args.edits:
+            samples[kind] = {phase: [] for phase in phases}
+            for _ in range(args.repeats):
+                # the change of modification time must be visible
+                time.sleep(args.interval)
+                written = time.monotonic()
+                program.edit(kind)
+                reload = wait_for_reload(metrics_path, sequence, args.timeout)
+                sequence = reload['sequence']
+                measured = dict(reload['phases'])
+                measured['detect'] = reload['requested'] - written
+                measured['total'] = reload['first-block'] - written
+                for phase in phases:
+                    if phase in measured:
+                        samples[kind][phase].append(measured[phase])
+    finally:
+        proc.send_signal(signal.SIGTERM)
+        try:
+            proc.wait(10)
+        except subprocess.TimeoutExpired:
+            proc.kill()
+
+    return {kind: {phase: statistics.median(values) for phase, values in by_phase.items() if values}
+            for kind, by_phase in samples.items()}
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Measure the edit-to-sound latency.')
+    parser.add_argument('--jest', default='jest', help='the jest executable')
+    parser.add_argument('--configurations', help='the compile settings to measure, as JSON')
+    parser.add_argument('--edits', nargs='+', default=['comment', 'constant', 'structure'])
+    parser.add_argument('--repeats', type=int, default=5)
+    parser.add_argument('--interval', type=float, default=0.5, help='seconds between edits')
+    parser.add_argument('--timeout', type=float, default=60)
+    parser.add_argument('--output', help='write the results to this file')
+    args = parser.parse_args()
+
+    with open(args.configurations or os.path.join(corpus_dir, 'configurations.json')) as f:
+        configurations = json.load(f)
+
+    results = {}
+    for name, settings in sorted(configurations.items()):
+        work_dir = tempfile.mkdtemp(prefix='jest-latency-')
+        try:
+            results[name] = measure_configuration(args, settings, work_dir)
+        finally:
+            shutil.rmtree(work_dir, ignore_errors=True)
+
+        for kind, medians in sorted(results[name].items()):
+            print('%-12s %-10s ' % (name, kind) +
+                  ' '.join('%s=%.1fms' % (phase, 1e3 * medians[phase]) for phase in phases if phase in medians))
+            sys.stdout.flush()
+
+    if args.output:
+        with open(args.output, 'w') as f:
+            json.dump(results, f, indent=4, sort_keys=True)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
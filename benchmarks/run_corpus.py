@@ -0,0 +1,129 @@
+#!/usr/bin/env python3
+#
+# Runs the benchmark corpus through `jest --bench`, and compares the results
+# with a baseline.
+#
+#   run_corpus.py --jest build/jest --output results.json
+#   run_corpus.py --jest build/jest --baseline baseline.json
+#   run_corpus.py --jest build/jest --baseline baseline.json --update-baseline
+#
+# Exits with status 1 if a measure regresses by more than the threshold.
+
+import argparse
+import json
+import os
+import subprocess
+import sys
+
+corpus_dir = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'corpus')
+
+# the measures compared against the baseline, higher is worse
+measures = [
+    'faust-seconds',
+    'cxx-seconds',
+    'module-size',
+    'ns-per-sample',
+]
+
+
+def run_bench(jest, dsp_file, settings, args):
+    cmd = [jest, '--bench', dsp_file,
+           '--settings', json.dumps(settings),
+           '--block-sizes', str(args.block_size),
+           '--sample-rates', str(args.sample_rate),
+           '--duration', str(args.duration)]
+    proc = subprocess.run(cmd, stdout=subprocess.PIPE, stderr=subprocess.PIPE, universal_newlines=True)
+    if proc.returncode != 0:
+        sys.stderr.write(proc.stderr)
+        raise RuntimeError('jest failed on %s' % dsp_file)
+    return json.loads(proc.stdout)
+
+
+def collect(args):
+    with open(args.configurations or os.path.join(corpus_dir, 'configurations.json')) as f:
+        configurations = json.load(f)
+
+    programs = sorted(name for name in os.listdir(corpus_dir) if name.endswith('.dsp'))
+    if args.filter:
+        programs = [name for name in programs if args.filter in name]
+
+    results = {}
+    for program in programs:
+        for config_name, settings in sorted(configurations.items()):
+            key = '%s/%s' % (os.path.splitext(program)[0], config_name)
+            sys.stderr.write('%s\n' % key)
+            report = run_bench(args.jest, os.path.join(corpus_dir, program), settings, args)
+            timings = report['compile-seconds']
+            results[key] = {
+                'faust-seconds': timings['faust'],
+                'cxx-seconds': timings['compile'] + timings['link'],
+                'module-size': report['module-size'],
+                'ns-per-sample': report['results'][0]['ns-per-sample'],
+                'ns-per-sample-stddev': report['results'][0]['ns-per-sample-stddev'],
+            }
+    return results
+
+
+def compare(results, baseline, threshold):
+    regressions = []
+    for key, entry in sorted(results.items()):
+        reference = baseline.get(key)
+        if reference is None:
+            print('%-40s (no baseline)' % key)
+            continue
+        for measure in measures:
+            old = reference.get(measure)
+            new = entry.get(measure)
+            if not old or new is None:
+                continue
+            change = (new - old) / old
+            flag = ''
+            if change > threshold:
+                flag = '  REGRESSION'
+                regressions.append((key, measure, change))
+            print('%-40s %-16s %14.4g -> %-14.4g %+7.1f%%%s' % (key, measure, old, new, 100 * change, flag))
+    return regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Run the benchmark corpus.')
+    parser.add_argument('--jest', default='jest', help='the jest executable')
+    parser.add_argument('--configurations', help='the compile settings to measure, as JSON')
+    parser.add_argument('--filter', help='only the programs whose name contains this text')
+    parser.add_argument('--block-size', type=int, default=256)
+    parser.add_argument('--sample-rate', type=int, default=48000)
+    parser.add_argument('--duration', type=float, default=2.0)
+    parser.add_argument('--output', help='write the results to this file')
+    parser.add_argument('--baseline', help='compare with the results in this file')
+    parser.add_argument('--update-baseline', action='store_true', help='replace the baseline with the results')
+    parser.add_argument('--threshold', type=float, default=0.1, help='relative change reported as a regression')
+    args = parser.parse_args()
+
+    results = collect(args)
+
+    if args.output:
+        with open(args.output, 'w') as f:
+            json.dump(results, f, indent=4, sort_keys=True)
+
+    if not args.baseline:
+        if not args.output:
+            json.dump(results, sys.stdout, indent=4, sort_keys=True)
+        return 0
+
+    if args.update_baseline:
+        with open(args.baseline, 'w') as f:
+            json.dump(results, f, indent=4, sort_keys=True)
+        return 0
+
+    with open(args.baseline) as f:
+        baseline = json.load(f)
+
+    regressions = compare(results, baseline, args.threshold)
+    if regressions:
+        print('%d regressions over %.0f%%' % (len(regressions), 100 * args.threshold))
+        return 1
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
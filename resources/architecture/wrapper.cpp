@@ -1,6 +1,7 @@
 #include <faust/dsp/dsp.h>
 #include <faust/gui/meta.h>
 #include <faust/gui/UI.h>
+#include <cstddef>
 
 <<includeIntrinsic>>
 <<includeclass>>
@@ -13,4 +14,10 @@ dsp *createDSPInstance()
     return new FAUSTCLASS;
 }
 
+__attribute__((visibility("default")))
+size_t getDSPInstanceSize()
+{
+    return sizeof(FAUSTCLASS);
+}
+
 } // extern "C"
@@ -1,6 +1,7 @@
 #include <faust/dsp/dsp.h>
 #include <faust/gui/meta.h>
 #include <faust/gui/UI.h>
+#include <cstddef>
 
 class mydsp final : public dsp {
 
@@ -86,4 +87,10 @@ dsp *createDSPInstance()
     return new mydsp;
 }
 
+__attribute__((visibility("default")))
+size_t getDSPInstanceSize()
+{
+    return sizeof(mydsp);
+}
+
 } // extern "C"
@@ -1,4 +1,5 @@
 #include "jest_app.h"
+#include "jest_headless.h"
 #include "utility/logs.h"
 #include <unistd.h>
 #include <thread>
@@ -32,6 +33,9 @@ static void signal_handler_term(int)
 ///
 int main(int argc, char *argv[])
 {
+    if (jest::isHeadlessCommand(argc, argv))
+        return jest::headlessMain(argc, argv);
+
     if (pipe(term_pipe.fd) != 0) {
         return 1;
     }
@@ -1,10 +1,17 @@
 #include "jest_app.h"
 #include "jest_settings_panel.h"
+#include "jest_report_panel.h"
+#include "jest_profiler.h"
 #include "jest_dsp.h"
 #include "jest_parameters.h"
 #include "jest_worker.h"
 #include "jest_client.h"
 #include "jest_file_helpers.h"
+#include "jest_memory.h"
+#include "jest_trace.h"
+#include "jest_metrics.h"
+#include "jest_module_file.h"
+#include "jest_shared_cache.h"
 #include "utility/logs.h"
 #include "ui_jest_main_window.h"
 #include "faust/MyQTUI.h"
@@ -23,6 +30,10 @@
 #include <QDir>
 #include <QDateTime>
 #include <QTimer>
+#include <QThread>
+#include <QElapsedTimer>
+#include <QCryptographicHash>
+#include <QLocale>
 #include <QCloseEvent>
 #include <QDragEnterEvent>
 #include <QDropEvent>
@@ -30,15 +41,28 @@
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QJsonArray>
+#include <QTextStream>
 #include <QDebug>
 #include <vector>
+#include <deque>
+#include <algorithm>
 #include <stdexcept>
+#include <ctime>
+#include <cstdlib>
+#include <thread>
 
 struct nsm_delete { void operator()(nsm_client_t *x) const noexcept { nsm_free(x); } };
 using nsm_u = std::unique_ptr<nsm_client_t, nsm_delete>;
 
 namespace jest {
 
+static uint64_t monotonic_ns() noexcept
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
 struct App::Impl {
     QSocketNotifier *_termPipeNotifier = nullptr;
     DSPWrapperPtr _dspWrapper;
@@ -49,11 +73,55 @@ struct App::Impl {
     QProgressIndicator *_spinner = nullptr;
     QLabel *_statusLabel = nullptr;
     SettingsPanel *_settingsPanel = nullptr;
+    ReportPanel *_reportPanel = nullptr;
     GUI *_faustUi = nullptr;
     QString _fileToLoad;
     QDateTime _fileToLoadMtime;
+    uint64_t _fileChangeTime = 0;
+    ReloadTimeline _reload;
     QTimer *_fileCheckTimer = nullptr;
+    QTimer *_speculationTimer = nullptr;
     CompileSettings _compileSettings;
+    std::thread _validationThread;
+
+    struct HistoryEntry {
+        DSPWrapperPtr wrapper;
+        QString fileName;
+        QByteArray source;
+        CompileSettings settings;
+        QDateTime time;
+    };
+    // most recent first, the modules stay loaded
+    std::deque<HistoryEntry> _history;
+
+    QAction *_comparisonAction = nullptr;
+    QLabel *_comparisonLabel = nullptr;
+    ComparisonStats _comparisonLast;
+    int _comparisonMode = kComparisonListenA;
+
+    QString _metricsSocket;
+    QString _traceFile;
+    std::unique_ptr<MetricsServer> _metrics;
+
+    bool _perfCountersEnabled = false;
+    QLabel *_perfLabel = nullptr;
+    PerfCounterValues _perfLastTotals;
+
+    bool _profiling = false;
+    Profiler _profiler;
+
+    bool _optimizationReport = false;
+    bool _throughputAnalysis = false;
+    // one analysis build at a time, the latest request waits for it
+    bool _analysisRunning = false;
+    bool _analysisPending = false;
+
+    bool _memoryReport = false;
+    DSPWrapper *_faultsWrapper = nullptr;
+    int _faultsThreadId = -1;
+    uint64_t _faultsInitial[2] = {};
+    uint64_t _faultsLast[2] = {};
+    QElapsedTimer _faultsTimer;
 
     nsm_u _nsmClient;
     bool _nsmIsOpen = false;
@@ -66,9 +134,25 @@ struct App::Impl {
     void newFaustFile();
     void newCxxFile();
     void loadFileEx(const QString &fileName, const QVector<float> &controlValues);
+    bool loadStoredModule(const QString &fileName, const QJsonObject &module, const QVector<float> &controlValues);
+    bool loadModuleFile(const QString &fileName);
+    void finishedLoading(const CompileRequest &request, const DSPWrapperPtr &wrapper);
+    void saveStoredModule(QJsonObject &root);
     void requestCurrentFile(const QVector<float> &controlValues);
+    void requestSpeculativeBuilds();
+    void requestAnalysis();
+    void finishedAnalysis(const CompileRequest &request, const CompileResult &result);
+    void addToHistory(const CompileRequest &request, const CompileResult &result);
+    void switchToHistory(size_t index);
+    void restoreHistorySource();
+    void updateHistoryMenu(QMenu *menu);
+    void compareWithHistory(size_t index);
+    void updateComparison();
     void startedCompiling(const CompileRequest &request);
     void finishedCompiling(const CompileRequest &request, const CompileResult &result);
+    void updatePerfCounters();
+    void updateProfiler();
+    void updateMemoryReport();
 
     ///
     class MainWindow : public QMainWindow {
@@ -95,12 +179,15 @@ App::App(int &argc, char **argv)
 {
     setApplicationName("jest");
     setApplicationDisplayName("Jest");
+    setApplicationVersion(JEST_VERSION);
 }
 
 App::~App()
 {
     Impl &impl = *_impl;
 
+    if (impl._validationThread.joinable())
+        impl._validationThread.join();
     delete impl._worker;
 }
 
@@ -121,17 +208,7 @@ void App::init(int termPipe)
     }
 
     ///
-    const QString &cacheDir = DSPWrapper::getCacheDirectory();
-    Log::i("Creating the cache directory");
-    QDir(cacheDir).mkpath(".");
-
-    const QString &wrapperFile = DSPWrapper::getWrapperFile();
-    Log::i("Creating the wrapper file");
-    {
-        QFile out(wrapperFile);
-        out.open(QFile::WriteOnly);
-        out.write(QResource("architecture/wrapper.cpp").uncompressedData());
-    }
+    DSPWrapper::setupCacheDirectory();
 
     ///
     Impl::MainWindow *window = new Impl::MainWindow;
@@ -142,6 +219,14 @@ void App::init(int termPipe)
     window->setWindowIcon(icon);
 
     ///
+    if (!qgetenv("JEST_PERF_COUNTERS").isEmpty())
+        impl._perfCountersEnabled = true;
+
+    impl._traceFile = QString::fromUtf8(qgetenv("JEST_TRACE"));
+    impl._metricsSocket = QString::fromUtf8(qgetenv("JEST_METRICS_SOCKET"));
+
+    impl._client.setBackendName(qgetenv("JEST_BACKEND").toStdString());
+
     const char *nsmUrl = getenv("NSM_URL");
     bool isUnderNsm = nsmUrl != nullptr;
     if (isUnderNsm) {
@@ -151,6 +236,17 @@ void App::init(int termPipe)
     else
         impl.initWithArgs();
 
+    impl._client.setPerfCountersEnabled(impl._perfCountersEnabled);
+
+    if (!impl._traceFile.isEmpty())
+        Trace::open(impl._traceFile.toStdString());
+    Trace::setThreadName("gui");
+
+    if (!impl._metricsSocket.isEmpty()) {
+        impl._metrics.reset(new MetricsServer(impl._client));
+        impl._metrics->listen(impl._metricsSocket);
+    }
+
     ///
     window->setWindowTitle(applicationDisplayName());
     if (!isUnderNsm)
@@ -199,6 +295,27 @@ void App::init(int termPipe)
     impl._spinner = spinner;
     toolBar->addWidget(spinner);
 
+    QLabel *comparisonLabel = new QLabel;
+    impl._comparisonLabel = comparisonLabel;
+    impl._comparisonAction = toolBar->addWidget(comparisonLabel);
+    impl._comparisonAction->setVisible(false);
+    comparisonLabel->setFrameShape(QFrame::Panel);
+    comparisonLabel->setFrameShadow(QFrame::Sunken);
+    comparisonLabel->setToolTip(tr("Compute time per block of the current module (A) and the compared one (B)"));
+
+    if (impl._perfCountersEnabled) {
+        QLabel *perfLabel = new QLabel;
+        impl._perfLabel = perfLabel;
+        toolBar->addWidget(perfLabel);
+        perfLabel->setFrameShape(QFrame::Panel);
+        perfLabel->setFrameShadow(QFrame::Sunken);
+
+        QTimer *perfTimer = new QTimer(this);
+        perfTimer->setInterval(1000);
+        connect(perfTimer, &QTimer::timeout, this, [&impl]() { impl.updatePerfCounters(); });
+        perfTimer->start();
+    }
+
     SettingsPanel *settingsPanel = new SettingsPanel;
     impl._settingsPanel = settingsPanel;
     window->addDockWidget(Qt::RightDockWidgetArea, settingsPanel);
@@ -220,6 +337,94 @@ void App::init(int termPipe)
             QMetaObject::invokeMethod(this, [this]() { _impl->_window->adjustSize(); }, Qt::QueuedConnection);
         });
 
+    ReportPanel *reportPanel = new ReportPanel;
+    impl._reportPanel = reportPanel;
+    window->addDockWidget(Qt::BottomDockWidgetArea, reportPanel);
+    reportPanel->setVisible(impl._windowUi.actionReports->isChecked());
+
+    connect(
+        impl._windowUi.actionReports, &QAction::toggled,
+        this, [this, reportPanel](bool checked) {
+            reportPanel->setVisible(checked);
+            QMetaObject::invokeMethod(this, [this]() { _impl->_window->adjustSize(); }, Qt::QueuedConnection);
+        });
+
+    QMenu *menuReports = new QMenu;
+    menuReports->addAction(impl._windowUi.actionOptimizationReport);
+    menuReports->addAction(impl._windowUi.actionThroughputAnalysis);
+    menuReports->addAction(impl._windowUi.actionMemoryReport);
+    impl._windowUi.actionReports->setMenu(menuReports);
+    qobject_cast<QToolButton *>(toolBar->widgetForAction(impl._windowUi.actionReports))
+        ->setPopupMode(QToolButton::MenuButtonPopup);
+
+    connect(
+        impl._windowUi.actionOptimizationReport, &QAction::toggled,
+        this, [this](bool checked) {
+            Impl &impl = *_impl;
+            impl._optimizationReport = checked;
+            if (checked)
+                impl._windowUi.actionReports->setChecked(true);
+            else
+                impl._reportPanel->removeReport(tr("Vectorization"));
+            if (checked && !impl._fileToLoad.isEmpty())
+                impl.requestAnalysis();
+        });
+
+    connect(
+        impl._windowUi.actionThroughputAnalysis, &QAction::toggled,
+        this, [this](bool checked) {
+            Impl &impl = *_impl;
+            impl._throughputAnalysis = checked;
+            if (checked)
+                impl._windowUi.actionReports->setChecked(true);
+            else
+                impl._reportPanel->removeReport(tr("Throughput"));
+            if (checked && !impl._fileToLoad.isEmpty())
+                impl.requestAnalysis();
+        });
+
+    connect(
+        impl._windowUi.actionMemoryReport, &QAction::toggled,
+        this, [this](bool checked) {
+            Impl &impl = *_impl;
+            impl._memoryReport = checked;
+            impl._faultsWrapper = nullptr;
+            if (checked) {
+                impl._windowUi.actionReports->setChecked(true);
+                impl.updateMemoryReport();
+            }
+            else
+                impl._reportPanel->removeReport(tr("Memory"));
+        });
+
+    connect(
+        impl._windowUi.actionProfile, &QAction::toggled,
+        this, [this](bool checked) {
+            Impl &impl = *_impl;
+            impl._profiling = checked;
+            if (checked)
+                impl._windowUi.actionReports->setChecked(true);
+            else {
+                impl._profiler.stop();
+                impl._profiler.clear();
+                impl._reportPanel->removeReport(tr("Hotspots"));
+            }
+            // rebuild with or without debugging information
+            if (!impl._fileToLoad.isEmpty())
+                impl.requestCurrentFile({});
+        });
+
+    QTimer *reportTimer = new QTimer(this);
+    reportTimer->setInterval(1000);
+    connect(
+        reportTimer, &QTimer::timeout,
+        this, [&impl]() {
+            impl.updateProfiler();
+            impl.updateMemoryReport();
+            impl.updateComparison();
+        });
+    reportTimer->start();
+
     connect(
         impl._windowUi.actionEdit, &QAction::triggered,
         this, [this]() {
@@ -235,6 +440,14 @@ void App::init(int termPipe)
     qobject_cast<QToolButton *>(toolBar->widgetForAction(impl._windowUi.actionNew))
         ->setPopupMode(QToolButton::InstantPopup);
 
+    QMenu *menuHistory = new QMenu;
+    impl._windowUi.actionHistory->setMenu(menuHistory);
+    qobject_cast<QToolButton *>(toolBar->widgetForAction(impl._windowUi.actionHistory))
+        ->setPopupMode(QToolButton::InstantPopup);
+    connect(
+        menuHistory, &QMenu::aboutToShow,
+        this, [&impl, menuHistory]() { impl.updateHistoryMenu(menuHistory); });
+
     connect(
         impl._windowUi.actionNewFaustFile, &QAction::triggered,
         this, [this]() {
@@ -261,6 +474,8 @@ void App::init(int termPipe)
             QDateTime mtime = QFileInfo(impl._fileToLoad).fileTime(QFile::FileModificationTime);
             if (mtime.isValid() && mtime != impl._fileToLoadMtime) {
                 Log::i("DSP file changed");
+                Trace::instant("mtime change");
+                impl._fileChangeTime = monotonic_ns();
                 impl._fileToLoadMtime = mtime;
                 impl.requestCurrentFile({});
             }
@@ -269,24 +484,48 @@ void App::init(int termPipe)
     ///
     impl._worker = new Worker(this);
 
+    QTimer *speculationTimer = new QTimer(this);
+    impl._speculationTimer = speculationTimer;
+    speculationTimer->setSingleShot(true);
+    speculationTimer->setInterval(2000);
+    connect(speculationTimer, &QTimer::timeout, this, [&impl]() { impl.requestSpeculativeBuilds(); });
+
+    // other jobs of the pool do not replace what is playing
     connect(
         impl._worker, &Worker::startedCompiling,
-        this, [&impl](const CompileRequest &request) { impl.startedCompiling(request); });
+        this, [&impl](const CompileRequest &request) {
+            if (request.priority == kCompilePriorityInteractive)
+                impl.startedCompiling(request);
+        });
     connect(
         impl._worker, &Worker::finishedCompiling,
-        this, [&impl](const CompileRequest &request, const CompileResult &result) { impl.finishedCompiling(request, result); });
+        this, [&impl](const CompileRequest &request, const CompileResult &result) {
+            if (request.priority == kCompilePriorityInteractive)
+                impl.finishedCompiling(request, result);
+            else if (request.priority == kCompilePriorityBackground)
+                impl.finishedAnalysis(request, result);
+        });
 }
 
 void App::shutdown()
 {
-    const QString &cacheDir = DSPWrapper::getCacheDirectory();
-    Log::i("Deleting the cache directory");
-    QDir(cacheDir).removeRecursively();
+    Impl &impl = *_impl;
+    if (impl._validationThread.joinable())
+        impl._validationThread.join();
+
+    DSPWrapper::cleanupCacheDirectory();
+
+    Trace::close();
 }
 
 void App::loadFile(const QString &fileName)
 {
     Impl &impl = *_impl;
+    if (QFileInfo(fileName).suffix() == "jestmod") {
+        if (!impl.loadModuleFile(fileName))
+            Log::e("Cannot load the module: %s", fileName.toUtf8().constData());
+        return;
+    }
     impl.loadFileEx(fileName, {});
 }
 
@@ -295,7 +534,7 @@ void App::chooseFile()
     Impl &impl = *_impl;
 
     QString fileName = QFileDialog::getOpenFileName(
-        impl._window, tr("Open file"), QString(), tr("Faust DSP (*.dsp);;C++ DSP (*.cxx)"));
+        impl._window, tr("Open file"), QString(), tr("Faust DSP (*.dsp);;C++ DSP (*.cxx);;Jest module (*.jestmod)"));
 
     if (fileName.isEmpty())
         return;
@@ -310,11 +549,42 @@ void App::Impl::initWithArgs()
 
     QCommandLineParser clp;
     clp.addPositionalArgument("file", tr("The file to open."));
+    const QCommandLineOption perfCountersOption("perf-counters", tr("Sample hardware performance counters in the audio thread."));
+    clp.addOption(perfCountersOption);
+    const QCommandLineOption traceOption("trace", tr("Write a timeline of the reload pipeline in Chrome trace format."), tr("file"));
+    clp.addOption(traceOption);
+    const QCommandLineOption metricsOption("metrics", tr("Serve metrics on a local socket, or in a directory."), tr("path"));
+    clp.addOption(metricsOption);
+    const QCommandLineOption backendOption("backend", tr("The audio backend: jack, or null."), tr("name"));
+    clp.addOption(backendOption);
+    const QCommandLineOption settingsOption("settings", tr("Compile settings, as JSON text or file."), tr("json"));
+    clp.addOption(settingsOption);
+    const QCommandLineOption loadOption("load", tr("Load a module built with `jest --build`, without compiling."), tr("module"));
+    clp.addOption(loadOption);
     clp.addHelpOption();
     clp.process(*self);
 
+    if (clp.isSet(perfCountersOption))
+        _perfCountersEnabled = true;
+    if (clp.isSet(metricsOption))
+        _metricsSocket = clp.value(metricsOption);
+    if (clp.isSet(backendOption))
+        _client.setBackendName(clp.value(backendOption).toStdString());
+    if (clp.isSet(settingsOption)) {
+        const QString settings = clp.value(settingsOption);
+        QFile file(settings);
+        const QByteArray data = file.open(QFile::ReadOnly) ? file.readAll() : settings.toUtf8();
+        const QJsonDocument doc = QJsonDocument::fromJson(data);
+        if (doc.isObject())
+            _compileSettings = compileSettingsFromJson(doc);
+        else
+            Log::w("Invalid compile settings");
+    }
+    if (clp.isSet(traceOption))
+        _traceFile = clp.value(traceOption);
+
     const QStringList positional = clp.positionalArguments();
-    const QString fileToLoad = positional.value(0);
+    const QString fileToLoad = clp.isSet(loadOption) ? clp.value(loadOption) : positional.value(0);
 
     if (!fileToLoad.isEmpty())
         QMetaObject::invokeMethod(self, [self, fileToLoad]() { self->loadFile(fileToLoad); }, Qt::QueuedConnection);
@@ -416,15 +686,452 @@ void App::Impl::loadFileEx(const QString &fileName, const QVector<float> &contro
     _fileCheckTimer->start();
 }
 
+// loads the module saved with the session, if it was built from the same source
+// for the same machine, and checks afterwards that a build would give the same
+// key, which covers the imported files and the toolchain
+bool App::Impl::loadStoredModule(const QString &fileName, const QJsonObject &module, const QVector<float> &controlValues)
+{
+    const QString soFile = _nsmSessionPath + ".so";
+    if (module.isEmpty() || !QFile::exists(soFile))
+        return false;
+
+    ModuleFingerprint fingerprint;
+    fingerprint.sourceHash = module["source-hash"].toString();
+    fingerprint.isa = module["isa"].toString();
+    fingerprint.toolchain = module["toolchain"].toString();
+
+    if (fingerprint.sourceHash.isEmpty() || fingerprint.sourceHash != DSPWrapper::hashSourceFile(fileName)) {
+        Log::i("The stored module is out of date");
+        return false;
+    }
+    if (fingerprint.isa != DSPWrapper::getIsa()) {
+        Log::i("The stored module is for another machine");
+        return false;
+    }
+
+    QByteArray soData;
+    {
+        QFile file(soFile);
+        if (!file.open(QFile::ReadOnly))
+            return false;
+        soData = file.readAll();
+    }
+    // checked before anything gets to run from the module
+    if (QString::fromLatin1(QCryptographicHash::hash(soData, QCryptographicHash::Sha1).toHex()) != module["module-hash"].toString()) {
+        Log::w("The stored module is corrupt");
+        return false;
+    }
+
+    // the wrapper deletes its file, so it loads a copy
+    const QString tempFile = DSPWrapper::makeTemporarySoFile();
+    {
+        QFile file(tempFile);
+        if (tempFile.isEmpty() || !file.open(QFile::WriteOnly | QFile::Truncate) || file.write(soData) != soData.size()) {
+            if (!tempFile.isEmpty())
+                QFile::remove(tempFile);
+            return false;
+        }
+    }
+
+    Log::i("Loading the stored module");
+    DSPWrapperPtr wrapper = DSPWrapper::load(tempFile, fingerprint);
+    if (!wrapper)
+        return false;
+
+    _fileToLoad = fileName;
+    _fileToLoadMtime = QFileInfo(fileName).fileTime(QFile::FileModificationTime);
+
+    CompileRequest request;
+    request.fileName = fileName;
+    request.settings = _compileSettings;
+    request.initialControlValues = controlValues;
+    finishedLoading(request, wrapper);
+
+    _fileCheckTimer->start();
+
+    ///
+    App *self = static_cast<App *>(QCoreApplication::instance());
+    CompileRequest keyRequest = request;
+    keyRequest.profiling = _profiling;
+    keyRequest.foreground = false;
+    const QString storedKey = module["module-key"].toString();
+    DSPWrapper *loaded = wrapper.get();
+    if (_validationThread.joinable())
+        _validationThread.join();
+    _validationThread = std::thread([this, self, keyRequest, storedKey, loaded]() {
+        bool valid = !storedKey.isEmpty() && DSPWrapper::computeModuleKey(keyRequest) == storedKey;
+        QMetaObject::invokeMethod(self, [this, valid, loaded]() {
+            DSPWrapperPtr current = _dspWrapper;
+            // a newer build has replaced it already
+            if (valid || current.get() != loaded)
+                return;
+            Log::i("The sources or the toolchain have changed, rebuilding the stored module");
+            std::vector<Parameter> inputParameters;
+            collectDspParameters(current->getDsp(), &inputParameters, nullptr);
+            QVector<float> controlValues;
+            for (const Parameter &parameter : inputParameters)
+                controlValues.push_back(*parameter.zone);
+            requestCurrentFile(controlValues);
+        }, Qt::QueuedConnection);
+    });
+
+    return true;
+}
+
+// loads a module built with `--build`, which has no source to watch
+bool App::Impl::loadModuleFile(const QString &fileName)
+{
+    ModuleManifest manifest;
+    DSPWrapperPtr wrapper = readModuleFile(fileName, &manifest);
+    if (!wrapper)
+        return false;
+
+    _fileCheckTimer->stop();
+    _fileToLoad.clear();
+    _fileToLoadMtime = QDateTime();
+
+    CompileRequest request;
+    request.fileName = fileName;
+    request.settings = manifest.settings;
+    finishedLoading(request, wrapper);
+    return true;
+}
+
+void App::Impl::finishedLoading(const CompileRequest &request, const DSPWrapperPtr &wrapper)
+{
+    CompileResult result;
+    result.dspWrapper = wrapper;
+
+    _reload = ReloadTimeline();
+    _reload.requested = _reload.changed = monotonic_ns();
+    finishedCompiling(request, result);
+}
+
+// stores the running module next to the session file
+void App::Impl::saveStoredModule(QJsonObject &root)
+{
+    const QString soFile = _nsmSessionPath + ".so";
+    QFile::remove(soFile);
+
+    DSPWrapperPtr wrapper = _dspWrapper;
+    if (!wrapper || wrapper->getFingerprint().sourceHash.isEmpty())
+        return;
+    if (!QFile::copy(wrapper->getSoFile(), soFile)) {
+        Log::w("Cannot store the module in the session");
+        return;
+    }
+
+    const ModuleFingerprint &fingerprint = wrapper->getFingerprint();
+    QJsonObject module;
+    module["module-hash"] = wrapper->getModuleHash();
+    module["source-hash"] = fingerprint.sourceHash;
+    module["isa"] = fingerprint.isa;
+    module["toolchain"] = fingerprint.toolchain;
+    module["module-key"] = wrapper->getKey();
+    root["module"] = module;
+}
+
 void App::Impl::requestCurrentFile(const QVector<float> &controlValues)
 {
     CompileRequest req;
     req.fileName = _fileToLoad;
     req.settings = _compileSettings;
     req.initialControlValues = controlValues;
+    req.profiling = _profiling;
+    // an edit means the user is listening, hidden instances of a session go last
+    req.foreground = _window->isVisible() || _fileChangeTime != 0;
+    Trace::instant("compile request");
+    _speculationTimer->stop();
+    _worker->cancel(kCompilePrioritySpeculative);
+    _reload = ReloadTimeline();
+    _reload.requested = monotonic_ns();
+    _reload.changed = _fileChangeTime ? _fileChangeTime : _reload.requested;
+    _fileChangeTime = 0;
+    _worker->request(req);
+    requestAnalysis();
+}
+
+// the reports come from a build of their own, so the one which plays stays fast
+void App::Impl::requestAnalysis()
+{
+    if (_fileToLoad.isEmpty() || (!_optimizationReport && !_throughputAnalysis))
+        return;
+    if (_analysisRunning) {
+        _analysisPending = true;
+        return;
+    }
+
+    CompileRequest req;
+    req.fileName = _fileToLoad;
+    req.settings = _compileSettings;
+    req.profiling = _profiling;
+    req.optimizationReport = _optimizationReport;
+    req.throughputAnalysis = _throughputAnalysis;
+    req.foreground = _window->isVisible();
+    req.priority = kCompilePriorityBackground;
+    req.prebuild = true;
+    _analysisRunning = true;
     _worker->request(req);
 }
 
+void App::Impl::finishedAnalysis(const CompileRequest &request, const CompileResult &result)
+{
+    _analysisRunning = false;
+    // a newer source or setting is waiting, this result is out of date
+    if (_analysisPending) {
+        _analysisPending = false;
+        requestAnalysis();
+        return;
+    }
+
+    if (request.optimizationReport && _optimizationReport)
+        _reportPanel->setReport(tr("Vectorization"), result.optimizationReport);
+    if (request.throughputAnalysis && _throughputAnalysis)
+        _reportPanel->setReport(tr("Throughput"), result.throughputReport);
+}
+
+// prebuilds the settings likely to be tried next, so that switching to them finds them in the shared cache
+void App::Impl::requestSpeculativeBuilds()
+{
+    static const unsigned maxBuilds = []() -> unsigned {
+        bool ok = false;
+        unsigned count = qgetenv("JEST_SPECULATIVE_BUILDS").toUInt(&ok);
+        return ok ? count : 8;
+    }();
+
+    if (maxBuilds == 0 || _fileToLoad.isEmpty())
+        return;
+    if (SharedCacheEntry::getDirectory().isEmpty())
+        return;
+
+    // only when the machine is idle, otherwise check again later
+    double load = 0;
+    if (getloadavg(&load, 1) == 1 && load > 0.5 * QThread::idealThreadCount()) {
+        _speculationTimer->start();
+        return;
+    }
+
+    const std::vector<CompileSettings> neighbours = getNeighbourSettings(_compileSettings);
+    for (size_t i = 0, n = std::min<size_t>(neighbours.size(), maxBuilds); i < n; ++i) {
+        CompileRequest req;
+        req.fileName = _fileToLoad;
+        req.settings = neighbours[i];
+        req.profiling = _profiling;
+        req.foreground = false;
+        req.priority = kCompilePrioritySpeculative;
+        req.prebuild = true;
+        _worker->request(req);
+    }
+}
+
+///
+void App::Impl::addToHistory(const CompileRequest &request, const CompileResult &result)
+{
+    static const size_t maxEntries = []() -> size_t {
+        bool ok = false;
+        unsigned count = qgetenv("JEST_HISTORY_SIZE").toUInt(&ok);
+        return ok ? count : 8;
+    }();
+
+    DSPWrapperPtr wrapper = result.dspWrapper;
+    for (const HistoryEntry &entry : _history) {
+        if (entry.wrapper == wrapper)
+            return;
+    }
+
+    HistoryEntry entry;
+    entry.wrapper = wrapper;
+    entry.fileName = request.fileName;
+    entry.source = result.source;
+    entry.settings = request.settings;
+    entry.time = QDateTime::currentDateTime();
+    _history.push_front(std::move(entry));
+
+    while (_history.size() > maxEntries)
+        _history.pop_back();
+}
+
+// installs a previous module by the hot-swap path, keeping the values of the controls with the same labels
+void App::Impl::switchToHistory(size_t index)
+{
+    if (index >= _history.size())
+        return;
+    const HistoryEntry entry = _history[index];
+    DSPWrapperPtr current = _dspWrapper;
+    if (entry.wrapper == current)
+        return;
+
+    std::vector<Parameter> currentParameters;
+    if (current)
+        collectDspParameters(current->getDsp(), &currentParameters, nullptr);
+    std::vector<Parameter> parameters;
+    collectDspParameters(entry.wrapper->getDsp(), &parameters, nullptr);
+
+    QVector<float> controlValues;
+    for (const Parameter &parameter : parameters) {
+        float value = parameter.init;
+        for (const Parameter &currentParameter : currentParameters) {
+            if (currentParameter.label == parameter.label) {
+                value = std::max(parameter.min, std::min(parameter.max, *currentParameter.zone));
+                break;
+            }
+        }
+        controlValues.push_back(value);
+    }
+
+    // edits continue from the file and the settings of this module
+    if (!entry.source.isEmpty()) {
+        _fileToLoad = entry.fileName;
+        _fileToLoadMtime = QFileInfo(entry.fileName).fileTime(QFile::FileModificationTime);
+        _fileCheckTimer->start();
+    }
+    _compileSettings = entry.settings;
+    if (SettingsPanel *settingsPanel = _settingsPanel) {
+        settingsPanel->blockSignals(true);
+        settingsPanel->setCurrentSettings(_compileSettings);
+        settingsPanel->blockSignals(false);
+    }
+
+    CompileRequest request;
+    request.fileName = entry.fileName;
+    request.settings = entry.settings;
+    request.initialControlValues = controlValues;
+    finishedLoading(request, entry.wrapper);
+}
+
+// puts back the source of the running module into its file
+void App::Impl::restoreHistorySource()
+{
+    DSPWrapperPtr current = _dspWrapper;
+    for (const HistoryEntry &entry : _history) {
+        if (entry.wrapper != current || entry.source.isEmpty())
+            continue;
+        QFile file(entry.fileName);
+        if (!file.open(QFile::WriteOnly | QFile::Truncate) || file.write(entry.source) != entry.source.size()) {
+            Log::e("Cannot restore the source: %s", entry.fileName.toUtf8().constData());
+            return;
+        }
+        file.close();
+        // the running module is this source already
+        if (_fileToLoad == entry.fileName)
+            _fileToLoadMtime = QFileInfo(entry.fileName).fileTime(QFile::FileModificationTime);
+        return;
+    }
+}
+
+// runs a previous module beside the current one, on the same input
+void App::Impl::compareWithHistory(size_t index)
+{
+    if (index >= _history.size())
+        return;
+    DSPWrapperPtr wrapper = _history[index].wrapper;
+    _client.setComparisonMode(_comparisonMode);
+    if (_client.setComparisonDsp(wrapper))
+        _comparisonLast = ComparisonStats();
+    updateComparison();
+}
+
+void App::Impl::updateComparison()
+{
+    bool comparing = _client.getComparisonDsp() != nullptr;
+    _comparisonAction->setVisible(comparing);
+    if (!comparing)
+        return;
+
+    const ComparisonStats stats = _client.getComparisonStats();
+    ComparisonStats &last = _comparisonLast;
+    if (stats.blocks < last.blocks)
+        last = ComparisonStats();
+    uint64_t blocks = stats.blocks - last.blocks;
+    double timeA = stats.timeA - last.timeA;
+    double timeB = stats.timeB - last.timeB;
+    last = stats;
+    if (blocks == 0)
+        return;
+
+    const QLocale locale;
+    _comparisonLabel->setText(
+        tr("A %1 us | B %2 us | B/A %3")
+        .arg(locale.toString(1e6 * timeA / blocks, 'f', 1))
+        .arg(locale.toString(1e6 * timeB / blocks, 'f', 1))
+        .arg(locale.toString((timeA > 0) ? (timeB / timeA) : 0.0, 'f', 2)));
+}
+
+void App::Impl::updateHistoryMenu(QMenu *menu)
+{
+    menu->clear();
+
+    DSPWrapperPtr current = _dspWrapper;
+    const QString floatNames[] = {tr("single"), tr("double"), tr("quad")};
+    const QString compilerNames[] = {tr("default"), tr("gcc"), tr("clang")};
+    QStringList labels;
+
+    for (size_t i = 0, n = _history.size(); i < n; ++i) {
+        const HistoryEntry &entry = _history[i];
+        const CompileSettings &settings = entry.settings;
+        QString text = QString("%1  %2  (%3, -O%4, %5")
+            .arg(entry.time.toString("HH:mm:ss"))
+            .arg(QFileInfo(entry.fileName).fileName())
+            .arg(compilerNames[std::min(std::max(settings.cxxCompiler, 0), 2)])
+            .arg(settings.cxxOpt)
+            .arg(floatNames[std::min(std::max(settings.faustFloat, 0), 2)]);
+        if (settings.faustVec)
+            text += QString(", -vs %1").arg(settings.faustVecSize);
+        text += ")";
+        labels.push_back(text);
+
+        QAction *action = menu->addAction(text);
+        action->setCheckable(true);
+        action->setChecked(entry.wrapper == current);
+        connect(action, &QAction::triggered, menu, [this, i]() { switchToHistory(i); });
+    }
+
+    if (_history.empty()) {
+        QAction *action = menu->addAction(tr("No builds yet"));
+        action->setEnabled(false);
+        return;
+    }
+
+    menu->addSeparator();
+    DSPWrapperPtr comparison = _client.getComparisonDsp();
+    QMenu *compareMenu = menu->addMenu(tr("Compare with"));
+    for (size_t i = 0, n = _history.size(); i < n; ++i) {
+        const HistoryEntry &entry = _history[i];
+        if (entry.wrapper == current)
+            continue;
+        QAction *action = compareMenu->addAction(labels[(int)i]);
+        action->setCheckable(true);
+        action->setChecked(entry.wrapper == comparison);
+        connect(action, &QAction::triggered, menu, [this, i]() { compareWithHistory(i); });
+    }
+    compareMenu->addSeparator();
+    QAction *stopAction = compareMenu->addAction(tr("Stop comparing"));
+    stopAction->setEnabled(comparison != nullptr);
+    connect(stopAction, &QAction::triggered, menu, [this]() {
+        _client.setComparisonDsp(nullptr);
+        updateComparison();
+    });
+
+    compareMenu->addSeparator();
+    const QString modeNames[] = {tr("Listen to A (current)"), tr("Listen to B"), tr("Null test (A - B)")};
+    for (int mode : {kComparisonListenA, kComparisonListenB, kComparisonNull}) {
+        QAction *action = compareMenu->addAction(modeNames[mode]);
+        action->setCheckable(true);
+        action->setChecked(mode == _comparisonMode);
+        connect(action, &QAction::triggered, menu, [this, mode]() {
+            _comparisonMode = mode;
+            _client.setComparisonMode(mode);
+        });
+    }
+
+    QAction *restoreAction = menu->addAction(tr("Restore the source of this build"));
+    bool canRestore = false;
+    for (const HistoryEntry &entry : _history)
+        canRestore = canRestore || (entry.wrapper == current && !entry.source.isEmpty());
+    restoreAction->setEnabled(canRestore);
+    connect(restoreAction, &QAction::triggered, menu, [this]() { restoreHistorySource(); });
+}
+
 void App::Impl::startedCompiling(const CompileRequest &request)
 {
     _spinner->startAnimation();
@@ -434,8 +1141,17 @@ void App::Impl::finishedCompiling(const CompileRequest &request, const CompileRe
 {
     _spinner->stopAnimation();
 
+    _reload.finished = monotonic_ns();
+    _reload.timings = result.timings;
+
     DSPWrapperPtr wrapper = result.dspWrapper;
     DSPWrapperPtr oldWrapper = _dspWrapper;
+
+    if (MetricsServer *metrics = _metrics.get()) {
+        metrics->recordCompile(result);
+        if (wrapper)
+            metrics->setModule(wrapper->getModuleHash(), request.fileName);
+    }
     _dspWrapper = wrapper;
 
     ///
@@ -468,7 +1184,13 @@ void App::Impl::finishedCompiling(const CompileRequest &request, const CompileRe
         return;
     }
 
-    _client.setDsp(wrapper);
+    _client.setDsp(wrapper, request.initialControlValues.data(), request.initialControlValues.size());
+    _profiler.clear();
+    _reload.swapped = monotonic_ns();
+    _speculationTimer->start();
+    addToHistory(request, result);
+
+    TraceScope trace("GUI rebuild");
 
     ///
     dsp *dsp = wrapper->getDsp();
@@ -476,7 +1198,7 @@ void App::Impl::finishedCompiling(const CompileRequest &request, const CompileRe
     ///
     GUI *faustUI = QTUI_create();
     _faustUi = faustUI;
-    dsp->buildUserInterface(faustUI);
+    buildDspInterface(dsp, faustUI);
     {
         mainLayout->addWidget(QTUI_widget(faustUI));
         mainLayout->addStretch();
@@ -487,7 +1209,151 @@ void App::Impl::finishedCompiling(const CompileRequest &request, const CompileRe
     }
     faustUI->run();
 
+    // the values are already playing, this undoes the rounding of the widgets
     _client.setControls(request.initialControlValues.data(), request.initialControlValues.size());
+
+    _reload.ready = monotonic_ns();
+    if (MetricsServer *metrics = _metrics.get())
+        metrics->recordReload(_reload);
+}
+
+void App::Impl::updatePerfCounters()
+{
+    QLabel *perfLabel = _perfLabel;
+    const PerfCounterValues totals = _client.getPerfCounterTotals();
+    PerfCounterValues &last = _perfLastTotals;
+
+    if (totals.availableMask == 0) {
+        perfLabel->setText(tr("Counters unavailable"));
+        perfLabel->setToolTip(QString());
+        last = totals;
+        return;
+    }
+
+    // totals are reset when the module changes
+    if (totals.frames < last.frames)
+        last = PerfCounterValues();
+
+    uint64_t deltas[kPerfCounterCount];
+    for (int i = 0; i < kPerfCounterCount; ++i)
+        deltas[i] = totals.counters[i] - last.counters[i];
+    uint64_t frames = totals.frames - last.frames;
+    last = totals;
+
+    if (frames == 0)
+        return;
+
+    auto available = [&totals](int id) -> bool { return totals.availableMask & (1u << id); };
+    auto perSample = [&deltas, frames](int id) -> double { return (double)deltas[id] / frames; };
+
+    QString ipc = (available(kPerfCycles) && available(kPerfInstructions) && deltas[kPerfCycles] > 0) ?
+        QString::number((double)deltas[kPerfInstructions] / deltas[kPerfCycles], 'f', 2) : QString("-");
+
+    QStringList fields;
+    fields << tr("IPC %1").arg(ipc);
+    if (available(kPerfL1DMisses))
+        fields << tr("L1D %1").arg(perSample(kPerfL1DMisses), 0, 'f', 2);
+    if (available(kPerfLLCMisses))
+        fields << tr("LLC %1").arg(perSample(kPerfLLCMisses), 0, 'f', 2);
+    if (available(kPerfBranchMisses))
+        fields << tr("Br %1").arg(perSample(kPerfBranchMisses), 0, 'f', 2);
+    perfLabel->setText(fields.join(" | "));
+
+    QStringList details;
+    if (available(kPerfCycles))
+        details << tr("Cycles per sample: %1").arg(perSample(kPerfCycles), 0, 'f', 1);
+    if (available(kPerfInstructions))
+        details << tr("Instructions per sample: %1").arg(perSample(kPerfInstructions), 0, 'f', 1);
+    if (available(kPerfL1DMisses))
+        details << tr("L1D read misses per sample: %1").arg(perSample(kPerfL1DMisses), 0, 'f', 3);
+    if (available(kPerfLLCMisses))
+        details << tr("LLC misses per sample: %1").arg(perSample(kPerfLLCMisses), 0, 'f', 3);
+    if (available(kPerfBranchMisses))
+        details << tr("Branch misses per sample: %1").arg(perSample(kPerfBranchMisses), 0, 'f', 3);
+    perfLabel->setToolTip(details.join('\n'));
+}
+
+void App::Impl::updateProfiler()
+{
+    DSPWrapperPtr wrapper = _dspWrapper;
+    if (!_profiling || !wrapper)
+        return;
+
+    int threadId = _client.getProcessThreadId();
+    if (threadId == -1)
+        return;
+
+    Profiler &profiler = _profiler;
+    if (profiler.getThreadId() != threadId && !profiler.start(threadId)) {
+        _windowUi.actionProfile->setChecked(false);
+        _reportPanel->setReport(tr("Hotspots"), tr("The audio thread cannot be sampled, check /proc/sys/kernel/perf_event_paranoid."));
+        return;
+    }
+
+    profiler.collect();
+    _reportPanel->setReport(tr("Hotspots"), profiler.report(wrapper->getSoFile(), wrapper->getCxxFile()));
+}
+
+void App::Impl::updateMemoryReport()
+{
+    DSPWrapperPtr wrapper = _dspWrapper;
+    if (!_memoryReport)
+        return;
+
+    if (!wrapper) {
+        _reportPanel->setReport(tr("Memory"), tr("No module loaded."));
+        return;
+    }
+
+    const QLocale locale;
+    auto formatSize = [&locale](int64_t size) -> QString {
+        QString text = locale.formattedDataSize(size < 0 ? -size : size);
+        return (size < 0) ? ("-" + text) : text;
+    };
+
+    const MemoryFootprint &footprint = wrapper->getMemoryFootprint();
+    const MappedSizes mapped = getMappedSizes(QFileInfo(wrapper->getSoFile()).canonicalFilePath().toStdString());
+
+    QString text;
+    QTextStream out(&text);
+    out << "Module: " << QFileInfo(wrapper->getSoFile()).fileName() << "\n";
+    out << "DSP instance size: "
+        << (footprint.instanceSize ? formatSize(footprint.instanceSize) : tr("unknown")) << "\n";
+    out << "Mapped text: " << formatSize(mapped.text)
+        << ", read-only data: " << formatSize(mapped.rodata)
+        << ", data: " << formatSize(mapped.data) << "\n";
+    out << "RSS delta on load: " << formatSize(footprint.loadRssDelta)
+        << ", on init: " << formatSize(footprint.initRssDelta) << "\n";
+    out << "Process RSS: " << formatSize(getResidentSetSize()) << "\n";
+
+    // page faults of the audio thread, since this module is running
+    int threadId = _client.getProcessThreadId();
+    uint64_t faults[2];
+    if (threadId != -1 && getThreadPageFaults(threadId, &faults[0], &faults[1])) {
+        if (_faultsWrapper != wrapper.get() || _faultsThreadId != threadId) {
+            _faultsWrapper = wrapper.get();
+            _faultsThreadId = threadId;
+            std::copy(faults, faults + 2, _faultsInitial);
+            std::copy(faults, faults + 2, _faultsLast);
+            _faultsTimer.start();
+        }
+        double elapsed = 1e-3 * _faultsTimer.restart();
+        double rates[2];
+        for (int i = 0; i < 2; ++i) {
+            rates[i] = (elapsed > 0) ? ((faults[i] - _faultsLast[i]) / elapsed) : 0.0;
+            _faultsLast[i] = faults[i];
+        }
+        out << "Audio thread page faults: "
+            << QString::number(rates[0], 'f', 1) << " minor/s, "
+            << QString::number(rates[1], 'f', 1) << " major/s "
+            << "(since load: " << (faults[0] - _faultsInitial[0]) << " minor, "
+            << (faults[1] - _faultsInitial[1]) << " major)\n";
+    }
+    else
+        out << "Audio thread page faults: unknown\n";
+
+    out.flush();
+    _reportPanel->setReport(tr("Memory"), text);
 }
 
 ///
@@ -548,7 +1414,7 @@ int App::Impl::nsmOpen(const char *path, const char *display_name, const char *c
     impl._nsmSessionPath = QString::fromUtf8(path);
     impl._nsmDisplayName = QString::fromUtf8(display_name);
 
-    if (!client.ensureJackClientOpened())
+    if (!client.ensureBackendOpened())
         return 1;
 
     ///
@@ -572,7 +1438,9 @@ int App::Impl::nsmOpen(const char *path, const char *display_name, const char *c
             for (int i = 0; i < numControlValues; ++i)
                 controlValuesFloat[i] = (float)controlValues[i].toDouble();
 
-            impl.loadFileEx(root["file-path"].toString(), controlValuesFloat);
+            const QString fileName = root["file-path"].toString();
+            if (!impl.loadStoredModule(fileName, root["module"].toObject(), controlValuesFloat))
+                impl.loadFileEx(fileName, controlValuesFloat);
         }
     }
 
@@ -604,6 +1472,8 @@ int App::Impl::nsmSave(char **out_msg, void *userdata)
             root["control-values"] = controlValues;
         }
 
+        impl.saveStoredModule(root);
+
         QJsonDocument doc;
         doc.setObject(root);
         file.write(doc.toJson(QJsonDocument::Indented));
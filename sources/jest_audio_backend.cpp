@@ -0,0 +1,17 @@
+#include "jest_audio_backend.h"
+#include "jest_jack_backend.h"
+#include "jest_null_backend.h"
+
+namespace jest {
+
+std::unique_ptr<AudioBackend> createAudioBackend(const std::string &name)
+{
+    std::unique_ptr<AudioBackend> backend;
+    if (name.empty() || name == "jack")
+        backend.reset(new JackBackend);
+    else if (name == "null")
+        backend.reset(new NullBackend(NullBackend::getSettingsFromEnvironment()));
+    return backend;
+}
+
+} // namespace jest
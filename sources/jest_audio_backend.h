@@ -0,0 +1,32 @@
+#pragma once
+#include <string>
+#include <memory>
+
+namespace jest {
+
+struct AudioCallbacks {
+    void (*threadInit)(void *arg) = nullptr;
+    void (*process)(float **inputs, float **outputs, unsigned nframes, void *arg) = nullptr;
+    void (*xrun)(void *arg) = nullptr;
+    void *arg = nullptr;
+};
+
+// The audio driver, which calls the processing from its own thread.
+class AudioBackend {
+public:
+    virtual ~AudioBackend() {}
+
+    virtual const char *getName() const noexcept = 0;
+    virtual bool open(const std::string &clientName, const AudioCallbacks &callbacks) = 0;
+    virtual unsigned getSampleRate() const noexcept = 0;
+
+    // the channels are reconfigured while the backend is inactive
+    virtual void activate() = 0;
+    virtual void deactivate() = 0;
+    virtual bool isActive() const noexcept = 0;
+    virtual void setChannelCount(unsigned numInputs, unsigned numOutputs) = 0;
+};
+
+std::unique_ptr<AudioBackend> createAudioBackend(const std::string &name);
+
+} // namespace jest
@@ -0,0 +1,225 @@
+#include "jest_build_process.h"
+#include "utility/logs.h"
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+
+namespace jest {
+
+enum {
+    kIoPriorityClassShift = 13,
+    kIoPriorityClassBestEffort = 2,
+    kIoPriorityClassIdle = 3,
+    kIoPriorityLowest = 7,
+    kIoPriorityWhoProcess = 1,
+    kKernelThreadFlag = 0x00200000,
+    kForegroundNice = 5,
+};
+
+static bool parseCpuList(const QString &text, cpu_set_t *cpus)
+{
+    CPU_ZERO(cpus);
+    for (const QString &item : text.split(',', Qt::SkipEmptyParts)) {
+        const QStringList range = item.trimmed().split('-');
+        bool ok1 = false, ok2 = true;
+        unsigned first = range.value(0).toUInt(&ok1);
+        unsigned last = (range.size() > 1) ? range.value(1).toUInt(&ok2) : first;
+        if (!ok1 || !ok2 || range.size() > 2 || last < first || last >= CPU_SETSIZE)
+            return false;
+        for (unsigned cpu = first; cpu <= last; ++cpu)
+            CPU_SET(cpu, cpus);
+    }
+    return CPU_COUNT(cpus) > 0;
+}
+
+static std::vector<std::string> listDirectory(const std::string &path)
+{
+    std::vector<std::string> names;
+    if (DIR *dir = opendir(path.c_str())) {
+        while (dirent *ent = readdir(dir)) {
+            if (ent->d_name[0] >= '0' && ent->d_name[0] <= '9')
+                names.push_back(ent->d_name);
+        }
+        closedir(dir);
+    }
+    return names;
+}
+
+cpu_set_t findRealtimeCpus()
+{
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(cpu_set_t), &allowed) != 0)
+        return cpus;
+
+    for (const std::string &pid : listDirectory("/proc")) {
+        const std::string taskDir = "/proc/" + pid + "/task";
+        for (const std::string &tid : listDirectory(taskDir)) {
+            std::ifstream in(taskDir + "/" + tid + "/stat");
+            std::string line;
+            if (!std::getline(in, line))
+                continue;
+            // the fields after the command, which can contain anything
+            size_t pos = line.rfind(')');
+            if (pos == std::string::npos)
+                continue;
+            std::istringstream fields(line.substr(pos + 1));
+            std::vector<std::string> values;
+            for (std::string value; fields >> value;)
+                values.push_back(value);
+            // state is field 3 of stat(5), flags 9 and policy 41
+            if (values.size() < 39)
+                continue;
+            unsigned long flags = std::strtoul(values[6].c_str(), nullptr, 10);
+            int policy = std::atoi(values[38].c_str());
+            if (flags & kKernelThreadFlag)
+                continue;
+            if (policy != SCHED_FIFO && policy != SCHED_RR)
+                continue;
+            // where a thread last ran says nothing about where it runs next,
+            // only a thread pinned to some of the CPUs keeps off the others
+            cpu_set_t affinity;
+            if (sched_getaffinity((pid_t)std::atoi(tid.c_str()), sizeof(cpu_set_t), &affinity) != 0)
+                continue;
+            cpu_set_t common;
+            CPU_AND(&common, &affinity, &allowed);
+            if (CPU_EQUAL(&common, &allowed))
+                continue;
+            CPU_OR(&cpus, &cpus, &affinity);
+        }
+    }
+
+    return cpus;
+}
+
+BuildIsolation getBuildIsolation(bool foreground)
+{
+    struct Settings {
+        bool explicitPriority = false;
+        bool explicitIo = false;
+        bool idle = true;
+        int nice = 0;
+        int ioPriority = kIoPriorityClassIdle << kIoPriorityClassShift;
+        bool autoAffinity = true;
+        bool fixedAffinity = false;
+        cpu_set_t cpus;
+        size_t memoryLimit = 0;
+    };
+
+    static const Settings settings = []() -> Settings {
+        Settings settings;
+
+        const QString priority = QString::fromUtf8(qgetenv("JEST_BUILD_PRIORITY"));
+        settings.explicitPriority = !priority.isEmpty();
+        if (priority == "normal")
+            settings.idle = false;
+        else if (!priority.isEmpty() && priority != "idle") {
+            bool ok = false;
+            int nice = priority.toInt(&ok);
+            if (ok) {
+                settings.idle = false;
+                settings.nice = nice;
+            }
+            else {
+                settings.explicitPriority = false;
+                Log::w("Invalid build priority: %s", priority.toUtf8().constData());
+            }
+        }
+
+        const QByteArray io = qgetenv("JEST_BUILD_IO");
+        settings.explicitIo = io == "normal" || io == "best-effort" || io == "idle";
+        if (io == "normal")
+            settings.ioPriority = -1;
+        else if (io == "best-effort")
+            settings.ioPriority = (kIoPriorityClassBestEffort << kIoPriorityClassShift) | kIoPriorityLowest;
+
+        const QString cpus = QString::fromUtf8(qgetenv("JEST_BUILD_CPUS"));
+        if (cpus == "all")
+            settings.autoAffinity = false;
+        else if (!cpus.isEmpty()) {
+            settings.autoAffinity = false;
+            settings.fixedAffinity = parseCpuList(cpus, &settings.cpus);
+            if (!settings.fixedAffinity)
+                Log::w("Invalid build CPU list: %s", cpus.toUtf8().constData());
+        }
+
+        settings.memoryLimit = (size_t)qgetenv("JEST_BUILD_MEMORY").toULongLong() << 20;
+
+        return settings;
+    }();
+
+    BuildIsolation isolation;
+    isolation.idle = settings.idle;
+    isolation.nice = settings.nice;
+    isolation.ioPriority = settings.ioPriority;
+    isolation.memoryLimit = settings.memoryLimit;
+
+    // under any other load, an idle build would starve while the user waits
+    if (foreground && !settings.explicitPriority) {
+        isolation.idle = false;
+        isolation.nice = kForegroundNice;
+    }
+    if (foreground && !settings.explicitIo)
+        isolation.ioPriority = (kIoPriorityClassBestEffort << kIoPriorityClassShift) | kIoPriorityLowest;
+
+    if (settings.fixedAffinity) {
+        isolation.useAffinity = true;
+        isolation.affinity = settings.cpus;
+    }
+    else if (settings.autoAffinity && sched_getaffinity(0, sizeof(cpu_set_t), &isolation.affinity) == 0) {
+        // the real-time threads move, so look where they are at each build
+        cpu_set_t realtime = findRealtimeCpus();
+        cpu_set_t remaining;
+        CPU_XOR(&remaining, &isolation.affinity, &realtime);
+        CPU_AND(&remaining, &remaining, &isolation.affinity);
+        // with every core busy with audio, building anywhere is the only choice
+        if (CPU_COUNT(&realtime) > 0 && CPU_COUNT(&remaining) > 0) {
+            isolation.useAffinity = true;
+            isolation.affinity = remaining;
+        }
+    }
+
+    return isolation;
+}
+
+///
+BuildProcess::BuildProcess(bool foreground, QObject *parent)
+    : QProcess(parent),
+      _isolation(getBuildIsolation(foreground))
+{
+}
+
+// runs in the child, between fork and exec
+void BuildProcess::setupChildProcess()
+{
+    const BuildIsolation &isolation = _isolation;
+
+    if (isolation.idle) {
+        sched_param param = {};
+        sched_setscheduler(0, SCHED_IDLE, &param);
+    }
+    else if (isolation.nice != 0)
+        setpriority(PRIO_PROCESS, 0, isolation.nice);
+
+    if (isolation.ioPriority != -1)
+        syscall(SYS_ioprio_set, kIoPriorityWhoProcess, 0, isolation.ioPriority);
+
+    if (isolation.useAffinity)
+        sched_setaffinity(0, sizeof(cpu_set_t), &isolation.affinity);
+
+    if (isolation.memoryLimit > 0) {
+        rlimit limit;
+        limit.rlim_cur = limit.rlim_max = isolation.memoryLimit;
+        setrlimit(RLIMIT_AS, &limit);
+    }
+}
+
+} // namespace jest
@@ -0,0 +1,35 @@
+#pragma once
+#include <QProcess>
+#include <sched.h>
+
+namespace jest {
+
+// How the build processes are kept out of the way of the audio.
+struct BuildIsolation {
+    bool idle = true;
+    int nice = 0;
+    int ioPriority = -1;
+    bool useAffinity = false;
+    cpu_set_t affinity;
+    size_t memoryLimit = 0;
+};
+
+// a build which the user waits for is only made nicer, others run when idle
+BuildIsolation getBuildIsolation(bool foreground);
+// the CPUs to which the user threads with a real-time policy are pinned; the
+// ones which may run anywhere cannot be avoided, and are left out
+cpu_set_t findRealtimeCpus();
+
+// A process of the compiler toolchain, started with the build isolation.
+class BuildProcess : public QProcess {
+public:
+    explicit BuildProcess(bool foreground, QObject *parent = nullptr);
+
+protected:
+    void setupChildProcess() override;
+
+private:
+    BuildIsolation _isolation;
+};
+
+} // namespace jest
@@ -0,0 +1,258 @@
+#include "jest_capacity.h"
+#include "jest_perf_counters.h"
+#include "utility/logs.h"
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <algorithm>
+#include <pthread.h>
+#include <sched.h>
+
+namespace jest {
+
+std::vector<int> getAvailableCpus()
+{
+    std::vector<int> cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &set))
+                cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+size_t getLastLevelCacheSize(int cpu)
+{
+    size_t size = 0;
+    int bestLevel = 0;
+
+    for (int index = 0;; ++index) {
+        const std::string dir = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/cache/index" + std::to_string(index);
+        std::ifstream levelFile(dir + "/level");
+        int level = 0;
+        if (!(levelFile >> level))
+            break;
+        std::ifstream sizeFile(dir + "/size");
+        size_t value = 0;
+        std::string unit;
+        if (!(sizeFile >> value))
+            continue;
+        sizeFile >> unit;
+        if (unit == "K")
+            value *= 1024;
+        else if (unit == "M")
+            value *= 1024 * 1024;
+        if (level >= bestLevel) {
+            bestLevel = level;
+            size = value;
+        }
+    }
+
+    return size;
+}
+
+///
+class SpinBarrier {
+public:
+    explicit SpinBarrier(unsigned count) : _count(count) {}
+
+    void wait() noexcept
+    {
+        unsigned generation = _generation.load(std::memory_order_acquire);
+        if (_waiting.fetch_add(1, std::memory_order_acq_rel) + 1 == _count) {
+            _waiting.store(0, std::memory_order_relaxed);
+            _generation.fetch_add(1, std::memory_order_release);
+        }
+        else {
+            while (_generation.load(std::memory_order_acquire) == generation)
+                std::this_thread::yield();
+        }
+    }
+
+private:
+    const unsigned _count;
+    std::atomic<unsigned> _waiting{0};
+    std::atomic<unsigned> _generation{0};
+};
+
+struct CapacityWorker {
+    int cpu = -1;
+    std::vector<double> callbackTimes;
+    PerfCounterValues perfTotals;
+    bool perfAvailable = false;
+};
+
+static void runCapacityWorker(CapacityWorker &worker, dsp *prototype, unsigned numInstances,
+                              const CapacitySettings &settings, const std::vector<float> &signal,
+                              std::mutex &initMutex, SpinBarrier &barrier)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(worker.cpu, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+        RTLog::w("Cannot pin a thread to CPU %d", worker.cpu);
+
+    // instances are allocated by the thread which runs them, for memory locality
+    std::vector<std::unique_ptr<dsp>> instances(numInstances);
+    std::vector<RenderBuffers> buffers(numInstances);
+    for (unsigned i = 0; i < numInstances; ++i) {
+        std::lock_guard<std::mutex> lock(initMutex);
+        instances[i].reset(prototype->clone());
+        instances[i]->init((int)settings.sampleRate);
+        buffers[i].resize(instances[i]->getNumInputs(), instances[i]->getNumOutputs(), settings.blockSize);
+        buffers[i].fillInputs(signal.data(), settings.blockSize);
+    }
+
+    PerfCounters perfCounters;
+    worker.perfAvailable = perfCounters.open();
+
+    const unsigned blockSize = settings.blockSize;
+    const unsigned warmupPeriods = settings.periods / 10;
+    worker.callbackTimes.clear();
+    worker.callbackTimes.reserve(settings.periods);
+
+    barrier.wait();
+
+    for (unsigned period = 0; period < warmupPeriods + settings.periods; ++period) {
+        barrier.wait();
+        bool measured = period >= warmupPeriods;
+        uint64_t start = monotonicTime();
+        if (measured)
+            perfCounters.begin();
+        for (unsigned i = 0; i < numInstances; ++i)
+            instances[i]->compute((int)blockSize, buffers[i].inputs(), buffers[i].outputs());
+        if (measured)
+            perfCounters.end(blockSize * numInstances);
+        uint64_t end = monotonicTime();
+        if (measured)
+            worker.callbackTimes.push_back((double)(end - start));
+    }
+
+    barrier.wait();
+
+    worker.perfTotals = perfCounters.getTotals();
+}
+
+static CapacityStep runCapacityStep(dsp *prototype, unsigned instancesPerThread, const std::vector<int> &cpus,
+                                    const CapacitySettings &settings, const std::vector<float> &signal)
+{
+    const unsigned numThreads = (unsigned)cpus.size();
+
+    std::vector<CapacityWorker> workers(numThreads);
+    std::vector<std::thread> threads(numThreads);
+    std::mutex initMutex;
+    SpinBarrier barrier(numThreads + 1);
+
+    for (unsigned t = 0; t < numThreads; ++t) {
+        workers[t].cpu = cpus[t];
+        threads[t] = std::thread(
+            [&, t]() { runCapacityWorker(workers[t], prototype, instancesPerThread, settings, signal, initMutex, barrier); });
+    }
+
+    // the controlling thread takes part in the barrier, to time the whole step
+    barrier.wait();
+    uint64_t start = monotonicTime();
+    for (unsigned period = 0; period < settings.periods / 10 + settings.periods; ++period)
+        barrier.wait();
+    barrier.wait();
+    double elapsed = 1e-9 * (monotonicTime() - start);
+
+    for (std::thread &thread : threads)
+        thread.join();
+
+    ///
+    CapacityStep step;
+    step.instancesPerThread = instancesPerThread;
+    step.numInstances = instancesPerThread * numThreads;
+
+    std::vector<double> callbackTimes;
+    uint64_t llcMisses = 0;
+    uint64_t frames = 0;
+    step.perfAvailable = true;
+    for (const CapacityWorker &worker : workers) {
+        callbackTimes.insert(callbackTimes.end(), worker.callbackTimes.begin(), worker.callbackTimes.end());
+        bool hasLlc = worker.perfAvailable && (worker.perfTotals.availableMask & (1u << kPerfLLCMisses));
+        step.perfAvailable = step.perfAvailable && hasLlc;
+        llcMisses += worker.perfTotals.counters[kPerfLLCMisses];
+        frames += worker.perfTotals.frames;
+    }
+
+    step.callbackTime = computeTimingStats(callbackTimes);
+    step.nsPerSample = step.callbackTime.mean / (instancesPerThread * settings.blockSize);
+
+    const double periodTime = 1e9 * settings.blockSize / settings.sampleRate;
+    step.fits = step.callbackTime.p99 <= periodTime;
+
+    if (step.perfAvailable && frames > 0) {
+        enum { kCacheLineSize = 64 };
+        step.llcMissesPerSample = (double)llcMisses / frames;
+        step.memoryBandwidth = (double)llcMisses * kCacheLineSize / elapsed;
+    }
+
+    Log::i("%u x %u instances: p99 %.0f ns of %.0f ns period, %.2f ns/sample",
+           numThreads, instancesPerThread, step.callbackTime.p99, periodTime, step.nsPerSample);
+
+    return step;
+}
+
+CapacityReport measureCapacity(dsp *prototype, const CapacitySettings &settings)
+{
+    CapacityReport report;
+    report.cpus = settings.cpus.empty() ? getAvailableCpus() : settings.cpus;
+    report.periodTime = 1e9 * settings.blockSize / settings.sampleRate;
+    if (report.cpus.empty())
+        return report;
+    report.llcSize = getLastLevelCacheSize(report.cpus.front());
+
+    const std::vector<float> signal = generateTestSignal(kSignalNoise, settings.sampleRate, settings.blockSize);
+
+    // a single instance on a single core, without contention
+    report.baseline = runCapacityStep(prototype, 1, std::vector<int>{report.cpus.front()}, settings, signal);
+    report.baseline.slowdown = 1;
+
+    auto runStep = [&](unsigned instancesPerThread) -> bool {
+        CapacityStep step = runCapacityStep(prototype, instancesPerThread, report.cpus, settings, signal);
+        step.slowdown = step.nsPerSample / report.baseline.nsPerSample;
+        report.steps.push_back(step);
+        if (step.fits)
+            report.maxInstancesPerThread = std::max(report.maxInstancesPerThread, instancesPerThread);
+        return step.fits;
+    };
+
+    // bracket the capacity by doubling, then bisect
+    unsigned lo = 0;
+    unsigned hi = 0;
+    for (unsigned count = 1; count <= settings.maxInstancesPerThread; count *= 2) {
+        if (!runStep(count)) {
+            hi = count;
+            break;
+        }
+        lo = count;
+    }
+    if (hi == 0 && lo < settings.maxInstancesPerThread) {
+        if (runStep(settings.maxInstancesPerThread))
+            lo = settings.maxInstancesPerThread;
+        else
+            hi = settings.maxInstancesPerThread;
+    }
+    while (hi != 0 && hi - lo > 1) {
+        unsigned mid = lo + (hi - lo) / 2;
+        if (runStep(mid))
+            lo = mid;
+        else
+            hi = mid;
+    }
+
+    std::sort(report.steps.begin(), report.steps.end(),
+              [](const CapacityStep &a, const CapacityStep &b) { return a.instancesPerThread < b.instancesPerThread; });
+
+    return report;
+}
+
+} // namespace jest
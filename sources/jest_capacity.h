@@ -0,0 +1,45 @@
+#pragma once
+#include "jest_render.h"
+#include <faust/dsp/dsp.h>
+#include <vector>
+#include <cstddef>
+
+namespace jest {
+
+struct CapacitySettings {
+    unsigned sampleRate = 48000;
+    unsigned blockSize = 256;
+    unsigned periods = 500;
+    unsigned maxInstancesPerThread = 256;
+    std::vector<int> cpus; // one pinned thread per CPU, all available if empty
+};
+
+struct CapacityStep {
+    unsigned instancesPerThread = 0;
+    unsigned numInstances = 0;
+    TimingStats callbackTime; // in nanoseconds
+    double nsPerSample = 0; // per instance
+    double slowdown = 0; // relative to a single instance alone
+    bool perfAvailable = false;
+    double llcMissesPerSample = 0;
+    double memoryBandwidth = 0; // in bytes per second
+    bool fits = false;
+};
+
+struct CapacityReport {
+    std::vector<int> cpus;
+    double periodTime = 0;
+    CapacityStep baseline;
+    std::vector<CapacityStep> steps;
+    unsigned maxInstancesPerThread = 0;
+    size_t llcSize = 0;
+};
+
+std::vector<int> getAvailableCpus();
+size_t getLastLevelCacheSize(int cpu);
+
+// Finds how many instances of a DSP can run on each CPU, while the 99th
+// percentile of the callback time stays within the period.
+CapacityReport measureCapacity(dsp *prototype, const CapacitySettings &settings);
+
+} // namespace jest
@@ -1,10 +1,11 @@
 #include "jest_client.h"
 #include "jest_dsp.h"
+#include "jest_memory.h"
 #include "jest_parameters.h"
+#include "jest_trace.h"
 #include "utility/logs.h"
-#include <algorithm>
-#include <cstring>
-#include <cstdlib>
+#include <sys/syscall.h>
+#include <unistd.h>
 
 namespace jest {
 
@@ -14,67 +15,107 @@ Client::Client()
 
 Client::~Client()
 {
-    if (jack_client_t *client = _lazyClient)
-        jack_client_close(client);
+    // stop the audio thread before the processor goes away
+    _lazyBackend.reset();
 }
 
-void Client::setDsp(DSPWrapperPtr dspWrapper)
+void Client::setDsp(DSPWrapperPtr dspWrapper, const float *controlValues, size_t numControlValues)
 {
-    jack_client_t *client = getJackClient();
+    TraceScope trace("Client::setDsp");
+    AudioBackend *backend = getBackend();
 
-    ///
-    size_t oldNumInputs = _inputs.size();
-    size_t oldNumOutputs = _outputs.size();
-    std::vector<std::vector<std::string>> inputConnections(oldNumInputs);
-    std::vector<std::vector<std::string>> outputConnections(oldNumOutputs);
-    for (size_t i = 0; i < oldNumInputs; ++i)
-        inputConnections[i] = saveJackConnections(_inputs[i]);
-    for (size_t i = 0; i < oldNumOutputs; ++i)
-        outputConnections[i] = saveJackConnections(_outputs[i]);
-
-    ///
-    jack_deactivate(client);
-
-    _dspWrapper = dspWrapper;
-
-    unsigned sampleRate = jack_get_sample_rate(client);
+    unsigned sampleRate = backend->getSampleRate();
 
     dsp *dsp = dspWrapper ? dspWrapper->getDsp() : nullptr;
+    unsigned numInputs = dsp ? dsp->getNumInputs() : 0;
+    unsigned numOutputs = dsp ? dsp->getNumOutputs() : 0;
+
+    // the comparison cannot share the instance, nor have other channels;
+    // it stops before the init, which it may be computing on otherwise
+    if (DSPWrapperPtr comparison = _comparisonWrapper) {
+        ::dsp *other = comparison->getDsp();
+        if (comparison == dspWrapper || (unsigned)other->getNumInputs() != numInputs || (unsigned)other->getNumOutputs() != numOutputs)
+            setComparisonDsp(nullptr);
+    }
+
     if (dsp) {
         Log::i("Initialize DSP");
+        int64_t rssBeforeInit = getResidentSetSize();
+        Trace::begin("dsp::init");
         dsp->init(sampleRate);
+        Trace::end("dsp::init");
+        dspWrapper->getMemoryFootprint().initRssDelta = getResidentSetSize() - rssBeforeInit;
+        setDspControls(dsp, controlValues, numControlValues);
     }
 
-    Log::i("Update JACK I/O");
-    updateJackIOs();
+    ///
+    if (backend->isActive() && numInputs == _numInputs && numOutputs == _numOutputs) {
+        // same channels: swap without interrupting the audio
+        _processor.setDsp(dsp);
+        if (!_processor.waitForCallbacks(2, 1000)) {
+            // the audio thread may be stalled inside the previous DSP
+            backend->deactivate();
+            backend->activate();
+        }
+        _dspWrapper = dspWrapper;
+        Log::s("Swapped DSP without interruption");
+        return;
+    }
 
-    jack_activate(client);
+    backend->deactivate();
 
-    ///
-    size_t newNumInputs = _inputs.size();
-    size_t newNumOutputs = _outputs.size();
+    _dspWrapper = dspWrapper;
+    _processor.setDsp(dsp);
+    _numInputs = numInputs;
+    _numOutputs = numOutputs;
+
+    Log::i("Update %s I/O", backend->getName());
+    backend->setChannelCount(numInputs, numOutputs);
 
-    Log::s("%zu inputs, %zu outputs", newNumInputs, newNumOutputs);
+    backend->activate();
 
-    for (size_t i = 0; i < std::min(oldNumInputs, newNumInputs); ++i)
-        restoreJackConnections(_inputs[i], inputConnections[i]);
-    for (size_t i = 0; i < std::min(oldNumOutputs, newNumOutputs); ++i)
-        restoreJackConnections(_outputs[i], outputConnections[i]);
+    Log::s("%u inputs, %u outputs", numInputs, numOutputs);
 }
 
-void Client::setControls(const float *initialValues, size_t numInitialValues)
+bool Client::setComparisonDsp(DSPWrapperPtr dspWrapper)
 {
-    DSPWrapperPtr dspWrapper = _dspWrapper;
+    TraceScope trace("Client::setComparisonDsp");
+    AudioBackend *backend = getBackend();
+
     dsp *dsp = dspWrapper ? dspWrapper->getDsp() : nullptr;
-    if (dsp && numInitialValues > 0) {
-        std::vector<Parameter> inputParameters;
-        collectDspParameters(dsp, &inputParameters, nullptr);
-        for (size_t i = 0; i < numInitialValues && i < inputParameters.size(); ++i) {
-            float lo = inputParameters[i].min;
-            float hi = inputParameters[i].max;
-            *inputParameters[i].zone = std::max(lo, std::min(hi, initialValues[i]));
+    if (dsp) {
+        if (dspWrapper == _dspWrapper || !_dspWrapper ||
+            dsp->getNumInputs() != _dspWrapper->getDsp()->getNumInputs() ||
+            dsp->getNumOutputs() != _dspWrapper->getDsp()->getNumOutputs())
+        {
+            Log::e("The modules to compare must have the same channels");
+            return false;
         }
     }
+
+    // the previous module may still be computing
+    if (_processor.getComparisonDsp()) {
+        _processor.setComparisonDsp(nullptr);
+        if (backend->isActive() && !_processor.waitForCallbacks(2, 1000)) {
+            backend->deactivate();
+            backend->activate();
+        }
+    }
+    _comparisonWrapper = nullptr;
+
+    if (!dsp)
+        return true;
+
+    dsp->init(backend->getSampleRate());
+    _processor.setComparisonDsp(dsp);
+    _comparisonWrapper = dspWrapper;
+    Log::s("Comparing with a second module");
+    return true;
+}
+
+void Client::setControls(const float *initialValues, size_t numInitialValues)
+{
+    _processor.setControls(initialValues, numInitialValues);
 }
 
 void Client::setClientName(const std::string &clientName)
@@ -82,140 +123,72 @@ void Client::setClientName(const std::string &clientName)
     _clientName = clientName;
 }
 
-jack_client_t *Client::getJackClient()
+void Client::setBackendName(const std::string &backendName)
 {
-    jack_client_t *client = _lazyClient;
-    if (client)
-        return client;
-
-    Log::i("Opening JACK client");
-
-    client = jack_client_open(_clientName.c_str(), JackNoStartServer, nullptr);
-    if (!client) {
-        panic("Could not open JACK client");
-    }
-
-    unsigned sampleRate = jack_get_sample_rate(client);
-    Log::s("New JACK client at %u Hz sample rate", sampleRate);
+    _backendName = backendName;
+}
 
-    jack_set_process_callback(client, &process, this);
+void Client::setBackend(std::unique_ptr<AudioBackend> backend)
+{
+    _pendingBackend = std::move(backend);
+}
 
-    _lazyClient = client;
-    return client;
+void Client::setPerfCountersEnabled(bool enabled)
+{
+    _perfCountersEnabled = enabled;
 }
 
-void Client::updateJackIOs()
+AudioBackend *Client::getBackend()
 {
-    jack_client_t *client = _lazyClient;
-    dsp *dsp = _dspWrapper ? _dspWrapper->getDsp() : nullptr;
+    AudioBackend *backend = _lazyBackend.get();
+    if (backend)
+        return backend;
 
-    size_t oldInputCount = _inputs.size();
-    size_t oldOutputCount = _outputs.size();
+    std::unique_ptr<AudioBackend> newBackend = std::move(_pendingBackend);
+    if (!newBackend)
+        newBackend = createAudioBackend(_backendName);
+    if (!newBackend)
+        panic("Unknown audio backend: %s", _backendName.c_str());
 
-    size_t newInputCount = dsp ? dsp->getNumInputs() : 0;
-    size_t newOutputCount = dsp ? dsp->getNumOutputs() : 0;
+    AudioCallbacks callbacks;
+    callbacks.threadInit = &threadInit;
+    callbacks.process = &process;
+    callbacks.xrun = &xrun;
+    callbacks.arg = this;
 
-    for (size_t i = oldInputCount; i < newInputCount; ++i) {
-        std::string name = "in_" + std::to_string(i + 1);
-        jack_port_t *port = jack_port_register(client, name.c_str(), JACK_DEFAULT_AUDIO_TYPE, JackPortIsInput, 0);
-        if (!port)
-            panic("Could not register JACK input");
-        _inputs.push_back(port);
-    }
-    for (size_t i = oldInputCount; i > newInputCount; --i) {
-        jack_port_t *port = _inputs.back();
-        if (jack_port_unregister(client, port) != 0)
-            panic("Could not unregister JACK input");
-        _inputs.pop_back();
-    }
+    if (!newBackend->open(_clientName, callbacks))
+        panic("Could not open %s client", newBackend->getName());
 
-    for (size_t i = oldOutputCount; i < newOutputCount; ++i) {
-        std::string name = "out_" + std::to_string(i + 1);
-        jack_port_t *port = jack_port_register(client, name.c_str(), JACK_DEFAULT_AUDIO_TYPE, JackPortIsOutput, 0);
-        if (!port)
-            panic("Could not register JACK output");
-        _outputs.push_back(port);
-    }
-    for (size_t i = oldOutputCount; i > newOutputCount; --i) {
-        jack_port_t *port = _outputs.back();
-        if (jack_port_unregister(client, port) != 0)
-            panic("Could not unregister JACK output");
-        _outputs.pop_back();
-    }
+    _processor.setSampleRate(newBackend->getSampleRate());
 
-    _portBufs.resize(newInputCount + newOutputCount);
+    _lazyBackend = std::move(newBackend);
+    return _lazyBackend.get();
 }
 
-std::vector<std::string> Client::saveJackConnections(jack_port_t *port)
+void Client::threadInit(void *arg)
 {
-    std::vector<std::string> connections;
-
-    const char **con = jack_port_get_connections(port);
-    if (!con)
-        return connections;
-
-    size_t count;
-    for (count = 0; con[count]; ++count);
+    Client *self = (Client *)arg;
 
-    connections.reserve(count);
-    for (size_t i = 0; i < count; ++i)
-        connections.emplace_back(con[i]);
+    self->_processThreadId.store((int)syscall(SYS_gettid), std::memory_order_relaxed);
+    Trace::setThreadName("audio");
 
-    jack_free(con);
-    return connections;
+    // the events are bound to the thread, and each activation has a new one
+    PerfCounters &perfCounters = self->_processor.getPerfCounters();
+    if (self->_perfCountersEnabled)
+        perfCounters.open();
 }
 
-void Client::restoreJackConnections(jack_port_t *port, const std::vector<std::string> &connections)
+void Client::process(float **inputs, float **outputs, unsigned nframes, void *arg)
 {
-    jack_client_t *client = getJackClient();
-    int flags = jack_port_flags(port);
-
-    const char *src = nullptr;
-    const char *dst = nullptr;
-
-    if (flags & JackPortIsOutput)
-        src = jack_port_name(port);
-    else
-        dst = jack_port_name(port);
-
-    size_t count = connections.size();
-    for (size_t i = 0; i < count; ++i) {
-        if (flags & JackPortIsOutput)
-            dst = connections[i].c_str();
-        else
-            src = connections[i].c_str();
-        jack_connect(client, src, dst);
-    }
+    Client *self = (Client *)arg;
+    self->_processor.process(inputs, outputs, self->_numOutputs, nframes);
 }
 
-int Client::process(jack_nframes_t nframes, void *arg)
+void Client::xrun(void *arg)
 {
     Client *self = (Client *)arg;
-
-    size_t numInputs = self->_inputs.size();
-    size_t numOutputs = self->_outputs.size();
-
-    float **inputs = self->_portBufs.data();
-    float **outputs = inputs + numInputs;
-
-    for (size_t i = 0; i < numInputs; ++i) {
-        inputs[i] = (float *)jack_port_get_buffer(self->_inputs[i], nframes);
-    }
-    for (size_t i = 0; i < numOutputs; ++i) {
-        outputs[i] = (float *)jack_port_get_buffer(self->_outputs[i], nframes);
-    }
-
-    dsp *dsp = self->_dspWrapper ? self->_dspWrapper->getDsp() : nullptr;
-
-    if (dsp) {
-        dsp->compute((int)nframes, inputs, outputs);
-    }
-    else {
-        for (size_t i = 0; i < numOutputs; ++i)
-            std::memset(outputs[i], 0, nframes * sizeof(float));
-    }
-
-    return 0;
+    self->_processor.countXrun();
+    RTLog::w("Audio xrun");
 }
 
 } // namespace jest
@@ -1,8 +1,10 @@
 #pragma once
-#include <jack/jack.h>
+#include "jest_processor.h"
+#include "jest_audio_backend.h"
 #include <string>
 #include <vector>
 #include <memory>
+#include <atomic>
 class DSPWrapper;
 using DSPWrapperPtr = std::shared_ptr<DSPWrapper>;
 
@@ -12,27 +14,45 @@ class Client {
 public:
     Client();
     ~Client();
-    void setDsp(DSPWrapperPtr dspWrapper);
+    // the control values are set between the init and the first block
+    void setDsp(DSPWrapperPtr dspWrapper, const float *controlValues = nullptr, size_t numControlValues = 0);
     void setControls(const float *initialValues, size_t numInitialValues);
+    // runs a second module beside the first, with the same channels, or none
+    bool setComparisonDsp(DSPWrapperPtr dspWrapper);
+    const DSPWrapperPtr &getComparisonDsp() const noexcept { return _comparisonWrapper; }
+    void setComparisonMode(int mode) noexcept { _processor.setComparisonMode(mode); }
+    ComparisonStats getComparisonStats() const noexcept { return _processor.getComparisonStats(); }
     void setClientName(const std::string &clientName);
-    bool ensureJackClientOpened() { return getJackClient() != nullptr; }
+    void setBackendName(const std::string &backendName);
+    // uses this backend instead of creating one by name, before it is opened
+    void setBackend(std::unique_ptr<AudioBackend> backend);
+    bool ensureBackendOpened() { return getBackend() != nullptr; }
 
-private:
-    jack_client_t *getJackClient();
-    void updateJackIOs();
+    void setPerfCountersEnabled(bool enabled);
+    PerfCounterValues getPerfCounterTotals() const noexcept { return _processor.getPerfCounters().getTotals(); }
+    int getProcessThreadId() const noexcept { return _processThreadId.load(std::memory_order_relaxed); }
+    CallbackStats getCallbackStats() const noexcept { return _processor.getCallbackStats(); }
+    uint64_t getFirstCallbackTime() const noexcept { return _processor.getFirstCallbackTime(); }
 
-    std::vector<std::string> saveJackConnections(jack_port_t *port);
-    void restoreJackConnections(jack_port_t *port, const std::vector<std::string> &connections);
+private:
+    AudioBackend *getBackend();
 
-    static int process(jack_nframes_t nframes, void *arg);
+    static void threadInit(void *arg);
+    static void process(float **inputs, float **outputs, unsigned nframes, void *arg);
+    static void xrun(void *arg);
 
 private:
     DSPWrapperPtr _dspWrapper;
-    jack_client_t *_lazyClient = nullptr;
-    std::vector<jack_port_t *> _inputs;
-    std::vector<jack_port_t *> _outputs;
-    std::vector<float *> _portBufs;
+    DSPWrapperPtr _comparisonWrapper;
+    std::unique_ptr<AudioBackend> _lazyBackend;
+    unsigned _numInputs = 0;
+    unsigned _numOutputs = 0;
+    std::unique_ptr<AudioBackend> _pendingBackend;
     std::string _clientName{"jest"};
+    std::string _backendName;
+    bool _perfCountersEnabled = false;
+    std::atomic<int> _processThreadId{-1};
+    Processor _processor;
 };
 
 } // namespace jest
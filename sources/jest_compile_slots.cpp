@@ -0,0 +1,124 @@
+#include "jest_compile_slots.h"
+#include "jest_trace.h"
+#include "utility/logs.h"
+#include <QStandardPaths>
+#include <QThread>
+#include <QDir>
+#include <sys/file.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <vector>
+#include <algorithm>
+#include <cerrno>
+
+namespace jest {
+
+enum {
+    kCompileSlotPollInterval = 20,
+};
+
+static const QString &getSlotDirectory()
+{
+    static QString dir = []() -> QString {
+        // the slots are shared by the processes of the user, like the runtime directory
+        const QString runtimeDir = QStandardPaths::writableLocation(QStandardPaths::RuntimeLocation);
+        const QString dir = runtimeDir.isEmpty() ?
+            QString("%1/jest-compile-slots-%2").arg(QDir::tempPath()).arg(getuid()) :
+            QString("%1/jest-compile-slots").arg(runtimeDir);
+        if (!QDir(dir).mkpath(".")) {
+            Log::w("Cannot create the compile slot directory");
+            return QString();
+        }
+        return dir;
+    }();
+    return dir;
+}
+
+static int openLockFile(const QString &fileName)
+{
+    return open(fileName.toUtf8().constData(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+}
+
+static bool tryLock(int fd, int operation)
+{
+    int ret;
+    while ((ret = flock(fd, operation | LOCK_NB)) == -1 && errno == EINTR);
+    return ret == 0;
+}
+
+unsigned CompileSlot::getCount()
+{
+    static unsigned count = []() -> unsigned {
+        const QByteArray data = qgetenv("JEST_COMPILE_JOBS");
+        bool ok = false;
+        unsigned count = data.toUInt(&ok);
+        if (ok)
+            return count;
+        // leaves the other half of the machine to the audio
+        return std::max(1, QThread::idealThreadCount() / 2);
+    }();
+    return count;
+}
+
+CompileSlot::CompileSlot(bool foreground)
+{
+    const unsigned count = getCount();
+    const QString &dir = getSlotDirectory();
+    if (count == 0 || dir.isEmpty())
+        return;
+
+    // foreground waiters hold this shared, which keeps background ones out
+    int priorityFd = openLockFile(dir + "/priority.lock");
+    if (priorityFd != -1 && foreground) {
+        while (flock(priorityFd, LOCK_SH) == -1 && errno == EINTR);
+    }
+
+    std::vector<int> slotFds;
+    for (unsigned i = 0; i < count; ++i) {
+        int fd = openLockFile(QString("%1/slot.%2.lock").arg(dir).arg(i));
+        if (fd != -1)
+            slotFds.push_back(fd);
+    }
+    if (slotFds.empty()) {
+        Log::w("Cannot open the compile slots, the builds are not limited");
+        if (priorityFd != -1)
+            close(priorityFd);
+        return;
+    }
+
+    TraceScope trace("compile slot");
+    bool waited = false;
+    while (_fd == -1 && !slotFds.empty()) {
+        bool eligible = foreground || priorityFd == -1;
+        if (!eligible && tryLock(priorityFd, LOCK_EX)) {
+            flock(priorityFd, LOCK_UN);
+            eligible = true;
+        }
+        for (size_t i = 0; eligible && _fd == -1 && i < slotFds.size(); ++i) {
+            if (tryLock(slotFds[i], LOCK_EX))
+                std::swap(_fd, slotFds[i]);
+        }
+        if (_fd == -1) {
+            if (!waited) {
+                Log::i("Waiting for a compile slot");
+                waited = true;
+            }
+            usleep(kCompileSlotPollInterval * 1000);
+        }
+    }
+
+    for (int fd : slotFds) {
+        if (fd != -1)
+            close(fd);
+    }
+    if (priorityFd != -1)
+        close(priorityFd);
+}
+
+CompileSlot::~CompileSlot()
+{
+    if (_fd != -1)
+        close(_fd);
+}
+
+} // namespace jest
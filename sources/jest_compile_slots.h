@@ -0,0 +1,23 @@
+#pragma once
+
+namespace jest {
+
+// A slot of the machine-wide limit on concurrent compilations, held for
+// as long as the object lives. Background requests only take a free slot
+// when no foreground request is waiting for one.
+class CompileSlot {
+public:
+    explicit CompileSlot(bool foreground);
+    ~CompileSlot();
+
+    CompileSlot(const CompileSlot &) = delete;
+    CompileSlot &operator=(const CompileSlot &) = delete;
+
+    // zero if unlimited
+    static unsigned getCount();
+
+private:
+    int _fd = -1;
+};
+
+} // namespace jest
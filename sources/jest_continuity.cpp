@@ -0,0 +1,135 @@
+#include "jest_continuity.h"
+#include <algorithm>
+#include <cmath>
+#include <ctime>
+
+namespace jest {
+
+enum {
+    kMinZeroRun = 2, // a sine does not hit exactly zero twice in a row
+    kGapPeriods = 4, // blocks later than this many periods are gaps
+};
+
+static const double kDiscontinuityThreshold = 1e-4;
+
+static uint64_t monotonic_ns() noexcept
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static float sineValue(double w, uint64_t n) noexcept
+{
+    return (float)(0.5 * std::sin(w * (double)n));
+}
+
+ContinuityProbe::ContinuityProbe(unsigned sampleRate, double frequency, size_t capacity, unsigned delay)
+    : _sampleRate(sampleRate), _frequency(frequency), _delay(delay), _samples(capacity), _blocks(capacity)
+{
+}
+
+void ContinuityProbe::generate(float **channels, unsigned numChannels, unsigned nframes) noexcept
+{
+    const double w = 2 * M_PI * _frequency / _sampleRate;
+    for (unsigned i = 0; i < nframes; ++i) {
+        float value = sineValue(w, _phase + i);
+        for (unsigned c = 0; c < numChannels; ++c)
+            channels[c][i] = value;
+    }
+    _phase += nframes;
+}
+
+void ContinuityProbe::capture(float **channels, unsigned numChannels, unsigned nframes) noexcept
+{
+    if (!_capturing.load(std::memory_order_acquire))
+        return;
+
+    if (numChannels == 0 || _numSamples + nframes > _samples.size() || _numBlocks == _blocks.size()) {
+        _overflow = true;
+        return;
+    }
+
+    // the capture follows the generator in the same cycle
+    CapturedBlock &block = _blocks[_numBlocks++];
+    block.time = monotonic_ns();
+    block.phase = _phase - nframes;
+    block.offset = _numSamples;
+
+    std::copy(channels[0], channels[0] + nframes, &_samples[_numSamples]);
+    _numSamples += nframes;
+}
+
+ContinuityReport ContinuityProbe::analyze(double periodTime) const
+{
+    ContinuityReport report;
+    report.samples = _numSamples;
+    report.blocks = _numBlocks;
+    report.overflow = _overflow;
+
+    // every sample is compared with the delayed input of the same cycle, so
+    // state lost, stale or out of order in the DSP leaves a residual
+    const double w = 2 * M_PI * _frequency / _sampleRate;
+    const float *x = _samples.data();
+    bool inDiscontinuity = false;
+    size_t silence = 0;
+    size_t zeroRun = 0;
+
+    auto endZeroRun = [&report, &zeroRun]() {
+        if (zeroRun >= kMinZeroRun)
+            ++report.zeroRuns;
+        report.longestZeroRun = std::max(report.longestZeroRun, zeroRun);
+        zeroRun = 0;
+    };
+
+    for (size_t b = 0; b < _numBlocks; ++b) {
+        const CapturedBlock &block = _blocks[b];
+        size_t end = (b + 1 < _numBlocks) ? _blocks[b + 1].offset : _numSamples;
+
+        if (_delay > 0 && silence == 0) {
+            size_t length = std::min<size_t>(_delay, _numSamples - block.offset);
+            if (length == _delay && std::all_of(x + block.offset, x + block.offset + length, [](float v) { return v == 0; })) {
+                ++report.restarts;
+                silence = _delay;
+            }
+        }
+
+        for (size_t n = block.offset; n < end; ++n) {
+            uint64_t index = block.phase + (n - block.offset);
+            float expected = 0;
+            if (silence > 0) {
+                --silence;
+                endZeroRun();
+            }
+            else {
+                if (index >= _delay)
+                    expected = sineValue(w, index - _delay);
+                if (x[n] == 0)
+                    ++zeroRun;
+                else
+                    endZeroRun();
+            }
+
+            double residual = (double)x[n] - expected;
+            bool discontinuous = std::fabs(residual) > kDiscontinuityThreshold;
+            if (discontinuous) {
+                report.discontinuityEnergy += residual * residual;
+                if (!inDiscontinuity)
+                    ++report.discontinuities;
+            }
+            inDiscontinuity = discontinuous;
+        }
+    }
+    endZeroRun();
+
+    for (size_t b = 1; b < _numBlocks; ++b) {
+        double interval = (double)(_blocks[b].time - _blocks[b - 1].time);
+        report.maxBlockInterval = std::max(report.maxBlockInterval, interval);
+        if (interval > kGapPeriods * periodTime)
+            ++report.gaps;
+    }
+
+    return report;
+}
+
+} // namespace jest
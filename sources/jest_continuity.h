@@ -0,0 +1,56 @@
+#pragma once
+#include <vector>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace jest {
+
+struct ContinuityReport {
+    uint64_t samples = 0;
+    uint64_t blocks = 0;
+    bool overflow = false;
+    uint64_t discontinuities = 0;
+    double discontinuityEnergy = 0;
+    uint64_t zeroRuns = 0;
+    size_t longestZeroRun = 0;
+    uint64_t gaps = 0;
+    double maxBlockInterval = 0; // in nanoseconds
+    uint64_t restarts = 0;
+};
+
+// A sine wave fed into the audio path, and the analysis of the stream which
+// comes out of it. The generator and the capture run on the audio thread.
+// The path delays the sine by `delay` samples, and a DSP which has just been
+// initialized outputs silence until its delay line is full: a restart.
+class ContinuityProbe {
+public:
+    ContinuityProbe(unsigned sampleRate, double frequency, size_t capacity, unsigned delay = 0);
+
+    void setCapturing(bool capturing) noexcept { _capturing.store(capturing, std::memory_order_release); }
+
+    void generate(float **channels, unsigned numChannels, unsigned nframes) noexcept;
+    void capture(float **channels, unsigned numChannels, unsigned nframes) noexcept;
+
+    // call after capture has stopped
+    ContinuityReport analyze(double periodTime) const;
+
+private:
+    const unsigned _sampleRate;
+    const double _frequency;
+    const unsigned _delay;
+    uint64_t _phase = 0;
+    std::atomic<bool> _capturing{false};
+    std::vector<float> _samples;
+    struct CapturedBlock {
+        uint64_t time = 0;
+        uint64_t phase = 0; // of the input
+        size_t offset = 0;
+    };
+    std::vector<CapturedBlock> _blocks;
+    size_t _numSamples = 0;
+    size_t _numBlocks = 0;
+    bool _overflow = false;
+};
+
+} // namespace jest
@@ -1,4 +1,10 @@
 #include "jest_dsp.h"
+#include "jest_opt_report.h"
+#include "jest_mca.h"
+#include "jest_trace.h"
+#include "jest_shared_cache.h"
+#include "jest_compile_slots.h"
+#include "jest_build_process.h"
 #include "utility/logs.h"
 #include <QStandardPaths>
 #include <QCoreApplication>
@@ -6,11 +12,65 @@
 #include <QFile>
 #include <QFileInfo>
 #include <QDir>
-#include <QTemporaryFile>
+#include <QResource>
+#include <QElapsedTimer>
+#include <QCryptographicHash>
 #include <QJsonObject>
 #include <QJsonArray>
+#include <QSysInfo>
+#include <QHash>
 #include <QDebug>
 #include <dlfcn.h>
+#include <mutex>
+#include <atomic>
+
+static bool isCppSource(const QString &fileName)
+{
+    static const QStringList cppFileSuffixes = {
+        "h", "hpp", "hxx", "hh",
+        "c", "cpp", "cxx", "cc",
+    };
+
+    return cppFileSuffixes.contains(QFileInfo(fileName).suffix().toLower());
+}
+
+// the interactive build which the user is waiting for
+static bool isUrgent(const CompileRequest &request)
+{
+    return request.foreground && request.priority == kCompilePriorityInteractive;
+}
+
+static bool generateCode(const CompileRequest &request, const QString &cppFile)
+{
+    const CompileSettings &settings = request.settings;
+    jest::BuildProcess proc(isUrgent(request));
+    proc.setProgram(DSPWrapper::getFaustProgram());
+    QStringList args;
+    args << "-o" << cppFile;
+    args << "-a" << DSPWrapper::getWrapperFile();
+    switch (settings.faustFloat) {
+    default:
+    case kCompilerSingleFloat:
+        args << "-single";
+        break;
+    case kCompilerDoubleFloat:
+        args << "-double";
+        break;
+    case kCompilerQuadFloat:
+        args << "-quad";
+        break;
+    }
+    if (settings.faustVec)
+        args << "-vec" << "-vs" << QString::number(settings.faustVecSize);
+    if (settings.faustMathApp)
+        args << "-mapp";
+    args << request.fileName;
+    proc.setArguments(args);
+    Log::i("$ %s %s", proc.program().toUtf8().constData() , proc.arguments().join(' ').toUtf8().constData());
+    proc.start();
+    proc.waitForFinished(-1);
+    return proc.exitStatus() == QProcess::NormalExit && proc.exitCode() == 0;
+}
 
 DSPWrapper::~DSPWrapper()
 {
@@ -18,124 +78,376 @@ DSPWrapper::~DSPWrapper()
         delete _dsp;
     if (_soHandle)
         dlclose(_soHandle);
-    if (!_soFile.isEmpty())
+    if (_ownsSoFile)
         QFile::remove(_soFile);
+    if (_ownsCxxFile)
+        QFile::remove(_cxxFile);
 }
 
 CompileResult DSPWrapper::compile(const CompileRequest &request)
 {
     CompileResult result;
     const CompileSettings &settings = request.settings;
+    CompileTimings &timings = result.timings;
+    QElapsedTimer timer;
 
     Log::i("Compiling DSP");
+    jest::TraceScope trace("DSPWrapper::compile");
 
-    static const QStringList cppFileSuffixes = {
-        "h", "hpp", "hxx", "hh",
-        "c", "cpp", "cxx", "cc",
-    };
+    bool sourceIsCpp = isCppSource(request.fileName);
 
-    QString fileSuffix = QFileInfo(request.fileName).suffix().toLower();
-    bool sourceIsCpp = cppFileSuffixes.contains(fileSuffix);
+    ModuleFingerprint fingerprint;
+    {
+        QFile file(request.fileName);
+        if (file.open(QFile::ReadOnly)) {
+            result.source = file.readAll();
+            fingerprint.sourceHash = QString::fromLatin1(QCryptographicHash::hash(result.source, QCryptographicHash::Sha1).toHex());
+        }
+    }
+    fingerprint.isa = getIsa();
+    fingerprint.toolchain = getToolchainFingerprint(settings);
 
-    QString cppFile = QString("%1/%2").arg(getCacheDirectory()).arg("file.cpp");
-    QString soFile = QString("%1/%2").arg(getCacheDirectory()).arg("file.XXXXXX.so");
+    // each job has its own files, so that several can build at once
+    QString soFile = makeTemporarySoFile();
+    const QString scratch = soFile.left(soFile.size() - 3);
+    QString cppFile = sourceIsCpp ? request.fileName : scratch + ".cpp";
+    auto discardGeneratedCode = [&]() {
+        if (!sourceIsCpp)
+            QFile::remove(cppFile);
+    };
 
-    {
-        QTemporaryFile temp(soFile);
-        if (!temp.open()) {
-            Log::e("DSP compilation failed (temporary file)");
+    if (!sourceIsCpp) {
+        jest::CompileSlot slot(request.foreground);
+        jest::TraceScope trace("faust");
+        timer.start();
+        bool generated = generateCode(request, cppFile);
+        timings.faust = 1e-9 * timer.nsecsElapsed();
+        if (!generated) {
+            Log::e("DSP compilation failed (faust)");
+            discardGeneratedCode();
             return result;
         }
-        soFile = temp.fileName();
     }
 
-    if (sourceIsCpp) {
-        cppFile = request.fileName;
+    // without analysis, the module can come from the cache shared with other processes
+    bool analysis = request.optimizationReport || request.throughputAnalysis;
+    QString key;
+    if (!analysis)
+        key = getModuleKey(request, cppFile, fingerprint);
+    std::unique_ptr<jest::SharedCacheEntry> cacheEntry;
+    if (!key.isEmpty() && request.useSharedCache && !jest::SharedCacheEntry::getDirectory().isEmpty()) {
+        cacheEntry.reset(new jest::SharedCacheEntry(key));
+        if (!cacheEntry->isLocked())
+            cacheEntry.reset();
     }
-    else
+
+    if (request.prebuild && !analysis && (!cacheEntry || cacheEntry->exists())) {
+        discardGeneratedCode();
+        return result;
+    }
+
+    if (cacheEntry && cacheEntry->exists()) {
+        timer.start();
+        DSPWrapperPtr wrapper = load(cacheEntry->getSoFile(), fingerprint, false);
+        timings.load = 1e-9 * timer.nsecsElapsed();
+        if (wrapper) {
+            Log::s("DSP found in the shared cache");
+            discardGeneratedCode();
+            if (sourceIsCpp)
+                wrapper->_cxxFile = cppFile;
+            else if (QFile::exists(cacheEntry->getCxxFile()))
+                wrapper->_cxxFile = cacheEntry->getCxxFile();
+            wrapper->_moduleKey = key;
+            result.dspWrapper = wrapper;
+            result.sharedCache = kSharedCacheHit;
+            return result;
+        }
+        Log::w("The cached module cannot be loaded, rebuilding");
+    }
+    if (cacheEntry)
+        result.sharedCache = kSharedCacheMiss;
+
+    // taken after the cache entry, a slot is never held while waiting for another build
+    std::unique_ptr<jest::CompileSlot> slot(new jest::CompileSlot(request.foreground));
+
+    QString objFile = scratch + ".o";
+
     {
-        QProcess proc;
-        proc.setProgram(getFaustProgram());
+        jest::TraceScope trace("c++ compile");
+        timer.start();
+        jest::BuildProcess proc(isUrgent(request));
+        proc.setProgram(getCxxProgram(settings));
         QStringList args;
-        args << "-o" << cppFile;
-        args << "-a" << getWrapperFile();
-        switch (settings.faustFloat) {
-        default:
-        case kCompilerSingleFloat:
-            args << "-single";
-            break;
-        case kCompilerDoubleFloat:
-            args << "-double";
-            break;
-        case kCompilerQuadFloat:
-            args << "-quad";
-            break;
-        }
-        if (settings.faustVec)
-            args << "-vec" << "-vs" << QString::number(settings.faustVecSize);
-        if (settings.faustMathApp)
-            args << "-mapp";
-        args << request.fileName;
+        args << "-I" << QFileInfo(request.fileName).dir().path();
+        args << getCxxFlags(settings);
+        if (request.profiling)
+            args << "-g" << "-fno-omit-frame-pointer";
+        if (request.optimizationReport)
+            args << jest::getOptimizationReportFlags(proc.program());
+        args << "-fPIC";
+        args << "-c";
+        args << "-o" << objFile;
+        args << cppFile;
         proc.setArguments(args);
         Log::i("$ %s %s", proc.program().toUtf8().constData() , proc.arguments().join(' ').toUtf8().constData());
         proc.start();
         proc.waitForFinished(-1);
+        timings.compile = 1e-9 * timer.nsecsElapsed();
+        if (request.optimizationReport)
+            result.optimizationReport = jest::formatOptimizationReport(QString::fromUtf8(proc.readAllStandardError()), cppFile);
         if (proc.exitStatus() != QProcess::NormalExit || proc.exitCode() != 0) {
-            Log::e("DSP compilation failed (faust)");
+            Log::e("DSP compilation failed (c++)");
+            QFile::remove(objFile);
+            discardGeneratedCode();
             return result;
         }
     }
 
     {
-        QProcess proc;
+        jest::TraceScope trace("link");
+        timer.start();
+        jest::BuildProcess proc(isUrgent(request));
         proc.setProgram(getCxxProgram(settings));
         QStringList args;
-        args << "-I" << QFileInfo(request.fileName).dir().path();
         args << getCxxFlags(settings);
         args << "-shared";
-        args << "-fPIC";
         args << "-o" << soFile;
-        args << cppFile;
+        args << objFile;
         args << getLdFlags(settings);
         proc.setArguments(args);
         Log::i("$ %s %s", proc.program().toUtf8().constData() , proc.arguments().join(' ').toUtf8().constData());
         proc.start();
         proc.waitForFinished(-1);
+        timings.link = 1e-9 * timer.nsecsElapsed();
+        QFile::remove(objFile);
         if (proc.exitStatus() != QProcess::NormalExit || proc.exitCode() != 0) {
-            Log::e("DSP compilation failed (c++)");
+            Log::e("DSP compilation failed (link)");
+            QFile::remove(soFile);
+            discardGeneratedCode();
             return result;
         }
     }
 
     Log::s("DSP compilation success");
 
+    if (request.throughputAnalysis) {
+        QStringList flags;
+        flags << "-I" << QFileInfo(request.fileName).dir().path();
+        flags << getCxxFlags(settings);
+        QString asmFile = scratch + ".s";
+        result.throughputReport = jest::analyzeThroughput(getCxxProgram(settings), flags, cppFile, asmFile);
+    }
+
+    slot.reset();
+
+    // identical modules of different processes map the same file, and share its pages
+    bool shared = cacheEntry && cacheEntry->store(soFile, sourceIsCpp ? QString() : cppFile);
+    if (shared || request.prebuild)
+        QFile::remove(soFile);
+    if (request.prebuild) {
+        discardGeneratedCode();
+        return result;
+    }
+    if (shared)
+        soFile = cacheEntry->getSoFile();
+
     ///
+    timer.start();
+    DSPWrapperPtr wrapper = load(soFile, fingerprint, !shared);
+    timings.load = 1e-9 * timer.nsecsElapsed();
+    if (!wrapper) {
+        discardGeneratedCode();
+        return result;
+    }
+
+    // keep the generated code of this module for analysis
+    wrapper->_cxxFile = cppFile;
+    if (shared) {
+        discardGeneratedCode();
+        if (!sourceIsCpp)
+            wrapper->_cxxFile = cacheEntry->getCxxFile();
+    }
+    else
+        wrapper->_ownsCxxFile = !sourceIsCpp;
+    wrapper->_moduleKey = key;
+
+    ///
+    result.dspWrapper = wrapper;
+    return result;
+}
+
+DSPWrapperPtr DSPWrapper::load(const QString &soFile, const ModuleFingerprint &fingerprint, bool ownsSoFile)
+{
     DSPWrapperPtr wrapper(new DSPWrapper);
+    wrapper->_soFile = soFile;
+    wrapper->_ownsSoFile = ownsSoFile;
+    wrapper->_fingerprint = fingerprint;
+    jest::MemoryFootprint &footprint = wrapper->_memoryFootprint;
+    int64_t rssBeforeLoad = jest::getResidentSetSize();
 
+    jest::Trace::begin("dlopen");
     void *soHandle = dlopen(soFile.toUtf8().data(), RTLD_LAZY);
+    jest::Trace::end("dlopen");
     if (!soHandle) {
         Log::e("DSP loading failed: %s", dlerror());
-        return result;
+        return nullptr;
     }
     wrapper->_soHandle = soHandle;
-    wrapper->_soFile = soFile;
 
     dsp *(*entry)() = (dsp *(*)())dlsym(soHandle, "createDSPInstance");
     if (!entry) {
         Log::e("DSP loading failed");
-        return result;
+        return nullptr;
     }
 
+    jest::Trace::begin("createDSPInstance");
     dsp *dsp = entry();
+    jest::Trace::end("createDSPInstance");
     if (!dsp) {
         Log::e("DSP instantiation failed");
-        return result;
+        return nullptr;
     }
     wrapper->_dsp = dsp;
 
-    ///
-    result.dspWrapper = wrapper;
-    return result;
+    size_t (*sizeEntry)() = (size_t (*)())dlsym(soHandle, "getDSPInstanceSize");
+    footprint.instanceSize = sizeEntry ? sizeEntry() : 0;
+    footprint.loadRssDelta = jest::getResidentSetSize() - rssBeforeLoad;
+
+    {
+        QFile file(soFile);
+        QCryptographicHash hash(QCryptographicHash::Sha1);
+        if (file.open(QFile::ReadOnly) && hash.addData(&file))
+            wrapper->_moduleHash = QString::fromLatin1(hash.result().toHex());
+    }
+
+    return wrapper;
+}
+
+// what the compiler gets to see: the generated code, or the preprocessed C++ source
+QString DSPWrapper::getModuleKey(const CompileRequest &request, const QString &cppFile, const ModuleFingerprint &fingerprint)
+{
+    const CompileSettings &settings = request.settings;
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(fingerprint.isa.toUtf8());
+    hash.addData(fingerprint.toolchain.toUtf8());
+    hash.addData(request.profiling ? "profiling" : "");
+
+    if (cppFile != request.fileName) {
+        QFile file(cppFile);
+        if (!file.open(QFile::ReadOnly) || !hash.addData(&file))
+            return QString();
+    }
+    else {
+        jest::TraceScope trace("preprocess");
+        jest::BuildProcess proc(isUrgent(request));
+        proc.setProgram(getCxxProgram(settings));
+        QStringList args;
+        args << "-I" << QFileInfo(request.fileName).dir().path();
+        args << getCxxFlags(settings);
+        args << "-E" << cppFile;
+        proc.setArguments(args);
+        proc.start();
+        proc.waitForFinished(-1);
+        if (proc.exitStatus() != QProcess::NormalExit || proc.exitCode() != 0)
+            return QString();
+        hash.addData(proc.readAllStandardOutput());
+    }
+
+    return QString::fromLatin1(hash.result().toHex());
+}
+
+// the key which a build of the request would have, without building it
+QString DSPWrapper::computeModuleKey(const CompileRequest &request)
+{
+    ModuleFingerprint fingerprint;
+    fingerprint.isa = getIsa();
+    fingerprint.toolchain = getToolchainFingerprint(request.settings);
+
+    if (isCppSource(request.fileName))
+        return getModuleKey(request, request.fileName, fingerprint);
+
+    const QString soFile = makeTemporarySoFile();
+    const QString cppFile = soFile.left(soFile.size() - 3) + ".cpp";
+    QString key;
+    if (generateCode(request, cppFile))
+        key = getModuleKey(request, cppFile, fingerprint);
+    QFile::remove(cppFile);
+    return key;
+}
+
+QString DSPWrapper::makeTemporarySoFile()
+{
+    // never reused, since dlopen would return the module previously opened by this name
+    static std::atomic<unsigned> counter{0};
+    return QString("%1/file.%2.so").arg(getCacheDirectory()).arg(++counter);
+}
+
+QString DSPWrapper::hashSourceFile(const QString &fileName)
+{
+    QFile file(fileName);
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    if (!file.open(QFile::ReadOnly) || !hash.addData(&file))
+        return QString();
+    return QString::fromLatin1(hash.result().toHex());
+}
+
+QString DSPWrapper::getIsa()
+{
+    return QSysInfo::currentCpuArchitecture() + "/" + QSysInfo::buildAbi();
+}
+
+QString DSPWrapper::getToolchainFingerprint(const CompileSettings &settings)
+{
+    // the output of `--version`, which does not change during the session
+    auto getVersion = [](const QString &program) -> QByteArray {
+        static std::mutex mutex;
+        static QHash<QString, QByteArray> known;
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = known.find(program);
+        if (it != known.end())
+            return *it;
+        QProcess proc;
+        proc.start(program, QStringList() << "--version");
+        proc.waitForFinished(-1);
+        QByteArray version = proc.readAllStandardOutput();
+        known.insert(program, version);
+        return version;
+    };
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    // a new version may change the interface of the modules, not only the wrapper
+    hash.addData(JEST_VERSION);
+    hash.addData(QResource(":/architecture/wrapper.cpp").uncompressedData());
+    hash.addData(getVersion(getFaustProgram()));
+    hash.addData(getVersion(getCxxProgram(settings)));
+    hash.addData(getCxxFlags(settings).join(' ').toUtf8());
+    hash.addData(getLdFlags(settings).join(' ').toUtf8());
+    hash.addData(compileSettingsToJson(settings).toJson(QJsonDocument::Compact));
+    return QString::fromLatin1(hash.result().toHex());
+}
+
+void DSPWrapper::setupCacheDirectory()
+{
+    const QString &cacheDir = getCacheDirectory();
+    Log::i("Creating the cache directory");
+    QDir(cacheDir).mkpath(".");
+
+    const QString &wrapperFile = getWrapperFile();
+    Log::i("Creating the wrapper file");
+    {
+        QFile out(wrapperFile);
+        out.open(QFile::WriteOnly);
+        out.write(QResource("architecture/wrapper.cpp").uncompressedData());
+    }
+
+    jest::SharedCacheEntry::prune();
+}
+
+void DSPWrapper::cleanupCacheDirectory()
+{
+    const QString &cacheDir = getCacheDirectory();
+    Log::i("Deleting the cache directory");
+    QDir(cacheDir).removeRecursively();
 }
 
 const QString &DSPWrapper::getCacheDirectory()
@@ -216,6 +528,48 @@ QJsonDocument compileSettingsToJson(const CompileSettings &settings)
     return document;
 }
 
+std::vector<CompileSettings> getNeighbourSettings(const CompileSettings &settings)
+{
+    std::vector<CompileSettings> neighbours;
+    auto add = [&settings, &neighbours](const CompileSettings &other) {
+        const QJsonDocument doc = compileSettingsToJson(other);
+        if (doc == compileSettingsToJson(settings))
+            return;
+        for (const CompileSettings &neighbour : neighbours) {
+            if (doc == compileSettingsToJson(neighbour))
+                return;
+        }
+        neighbours.push_back(other);
+    };
+
+    CompileSettings other = settings;
+    other.faustVec = !settings.faustVec;
+    add(other);
+
+    if (settings.faustVec) {
+        for (int size : {settings.faustVecSize / 2, settings.faustVecSize * 2,
+                         settings.faustVecSize - 4, settings.faustVecSize + 4}) {
+            if (size < kCompilerVectorSizeMin || size > kCompilerVectorSizeMax)
+                continue;
+            other = settings;
+            other.faustVecSize = size;
+            add(other);
+        }
+    }
+
+    for (int compiler : {kCompilerGCC, kCompilerClang}) {
+        other = settings;
+        other.cxxCompiler = compiler;
+        add(other);
+    }
+
+    other = settings;
+    other.faustFloat = (settings.faustFloat == kCompilerSingleFloat) ? kCompilerDoubleFloat : kCompilerSingleFloat;
+    add(other);
+
+    return neighbours;
+}
+
 CompileSettings compileSettingsFromJson(const QJsonDocument &document)
 {
     CompileSettings settings;
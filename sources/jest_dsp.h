@@ -1,10 +1,12 @@
 #pragma once
+#include "jest_memory.h"
 #include <faust/dsp/dsp.h>
 #include <QObject>
 #include <QString>
 #include <QJsonDocument>
 #include <QVector>
 #include <memory>
+#include <vector>
 
 class DSPWrapper;
 using DSPWrapperPtr = std::shared_ptr<DSPWrapper>;
@@ -13,6 +15,13 @@ struct CompileSettings;
 struct CompileRequest;
 struct CompileResult;
 
+// What a module was built from, to decide if it can be reused.
+struct ModuleFingerprint {
+    QString sourceHash;
+    QString isa;
+    QString toolchain;
+};
+
 class DSPWrapper {
 protected:
     DSPWrapper() = default;
@@ -21,8 +30,26 @@ public:
     ~DSPWrapper();
 
     static CompileResult compile(const CompileRequest &request);
+    // takes ownership of the file, which is deleted with the wrapper, unless it is shared
+    static DSPWrapperPtr load(const QString &soFile, const ModuleFingerprint &fingerprint, bool ownsSoFile = true);
     dsp *getDsp() noexcept { return _dsp; }
+    const QString &getSoFile() const noexcept { return _soFile; }
+    const QString &getCxxFile() const noexcept { return _cxxFile; }
+    const QString &getModuleHash() const noexcept { return _moduleHash; }
+    // what it was built from, empty for the builds with analysis
+    const QString &getKey() const noexcept { return _moduleKey; }
+    jest::MemoryFootprint &getMemoryFootprint() noexcept { return _memoryFootprint; }
+    const ModuleFingerprint &getFingerprint() const noexcept { return _fingerprint; }
 
+    static QString getModuleKey(const CompileRequest &request, const QString &cppFile, const ModuleFingerprint &fingerprint);
+    static QString computeModuleKey(const CompileRequest &request);
+    static QString makeTemporarySoFile();
+    static QString hashSourceFile(const QString &fileName);
+    static QString getIsa();
+    static QString getToolchainFingerprint(const CompileSettings &settings);
+
+    static void setupCacheDirectory();
+    static void cleanupCacheDirectory();
     static const QString &getCacheDirectory();
     static const QString &getWrapperFile();
     static const QString &getFaustProgram();
@@ -33,7 +60,14 @@ public:
 private:
     void *_soHandle = nullptr;
     QString _soFile;
+    bool _ownsSoFile = false;
+    QString _cxxFile;
+    bool _ownsCxxFile = false;
+    QString _moduleHash;
+    QString _moduleKey;
+    ModuleFingerprint _fingerprint;
     dsp *_dsp = nullptr;
+    jest::MemoryFootprint _memoryFootprint;
 };
 
 ///
@@ -66,14 +100,50 @@ struct CompileSettings {
 
 QJsonDocument compileSettingsToJson(const CompileSettings &settings);
 CompileSettings compileSettingsFromJson(const QJsonDocument &document);
+// the settings likely to be tried next from these, most likely first
+std::vector<CompileSettings> getNeighbourSettings(const CompileSettings &settings);
+
+enum CompilePriority {
+    kCompilePriorityInteractive,
+    kCompilePriorityBackground,
+    kCompilePrioritySpeculative,
+};
 
 struct CompileRequest {
     QString fileName;
     CompileSettings settings;
     QVector<float> initialControlValues;
+    bool profiling = false;
+    bool optimizationReport = false;
+    bool throughputAnalysis = false;
+    // whether the user is waiting for it, rather than a hidden instance
+    bool foreground = true;
+    // within the process, which job of the worker pool goes first
+    int priority = kCompilePriorityInteractive;
+    // only fill the shared cache, or produce the reports, without loading the module
+    bool prebuild = false;
+    bool useSharedCache = true;
+};
+struct CompileTimings {
+    double faust = 0;
+    double compile = 0;
+    double link = 0;
+    double load = 0;
 };
+enum SharedCacheStatus {
+    kSharedCacheBypassed,
+    kSharedCacheHit,
+    kSharedCacheMiss,
+};
+
 struct CompileResult {
     DSPWrapperPtr dspWrapper;
+    int sharedCache = kSharedCacheBypassed;
+    // the source as it was compiled
+    QByteArray source;
+    CompileTimings timings;
+    QString optimizationReport;
+    QString throughputReport;
 };
 
 Q_DECLARE_METATYPE(CompileRequest)
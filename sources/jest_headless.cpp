@@ -0,0 +1,637 @@
+#include "jest_headless.h"
+#include "jest_dsp.h"
+#include "jest_render.h"
+#include "jest_capacity.h"
+#include "jest_continuity.h"
+#include "jest_module_file.h"
+#include "jest_client.h"
+#include "jest_null_backend.h"
+#include "utility/logs.h"
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QDir>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include <chrono>
+#include <thread>
+#include <cstring>
+#include <cstdio>
+
+namespace jest {
+
+enum {
+    kExitSuccess = 0,
+    kExitFailure = 1,
+    kExitUsage = 2,
+    kExitOverBudget = 3,
+};
+
+enum {
+    kSwapTestDelay = 64,
+};
+
+static const char *const headless_commands[] = {
+    "--bench",
+    "--capacity",
+    "--swap-test",
+    "--build",
+    "--accuracy",
+};
+
+bool isHeadlessCommand(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; ++i) {
+        for (const char *command : headless_commands) {
+            if (std::strcmp(argv[i], command) == 0)
+                return true;
+        }
+    }
+    return false;
+}
+
+static bool parseSettings(const QString &text, CompileSettings *settings)
+{
+    QByteArray data;
+    QFile file(text);
+    if (file.open(QFile::ReadOnly))
+        data = file.readAll();
+    else
+        data = text.toUtf8();
+
+    QJsonParseError error;
+    QJsonDocument doc = QJsonDocument::fromJson(data, &error);
+    if (doc.isNull() || !doc.isObject()) {
+        Log::e("Invalid compile settings: %s", error.errorString().toUtf8().constData());
+        return false;
+    }
+
+    *settings = compileSettingsFromJson(doc);
+    return true;
+}
+
+static bool parseUnsignedList(const QString &text, std::vector<unsigned> *values)
+{
+    values->clear();
+    for (const QString &item : text.split(',', Qt::SkipEmptyParts)) {
+        bool ok = false;
+        unsigned value = item.trimmed().toUInt(&ok);
+        if (!ok || value == 0)
+            return false;
+        values->push_back(value);
+    }
+    return !values->empty();
+}
+
+static QJsonObject compileTimingsToJson(const CompileTimings &timings)
+{
+    QJsonObject obj;
+    obj["faust"] = timings.faust;
+    obj["compile"] = timings.compile;
+    obj["link"] = timings.link;
+    obj["load"] = timings.load;
+    return obj;
+}
+
+///
+struct BenchmarkOptions {
+    CompileSettings settings;
+    std::vector<unsigned> blockSizes{32, 64, 128, 256, 512, 1024};
+    std::vector<unsigned> sampleRates{48000};
+    double duration = 2.0;
+    TestSignal signal = kSignalNoise;
+    double maxLoad = 0;
+    std::vector<unsigned> cpus;
+    unsigned periods = 500;
+    unsigned maxInstances = 256;
+    unsigned swaps = 50;
+    unsigned swapInterval = 50;
+    bool allowXruns = false;
+    double minSnr = -std::numeric_limits<double>::infinity();
+};
+
+// measurements time a whole build, so they do not take it from the shared cache
+static DSPWrapperPtr compileModule(const QString &fileName, const CompileSettings &settings, QJsonObject &root, bool useSharedCache = false)
+{
+    CompileRequest request;
+    request.fileName = fileName;
+    request.settings = settings;
+    request.useSharedCache = useSharedCache;
+
+    CompileResult result = DSPWrapper::compile(request);
+    DSPWrapperPtr wrapper = result.dspWrapper;
+    if (!wrapper)
+        return nullptr;
+
+    dsp *instance = wrapper->getDsp();
+
+    root["file"] = fileName;
+    root["settings"] = compileSettingsToJson(settings).object();
+    root["compile-seconds"] = compileTimingsToJson(result.timings);
+    static const char *const sharedCacheNames[] = {"bypassed", "hit", "miss"};
+    root["shared-cache"] = sharedCacheNames[result.sharedCache];
+    root["module-size"] = (double)QFileInfo(wrapper->getSoFile()).size();
+    root["module-hash"] = wrapper->getModuleHash();
+    root["instance-size"] = (double)wrapper->getMemoryFootprint().instanceSize;
+    root["inputs"] = instance->getNumInputs();
+    root["outputs"] = instance->getNumOutputs();
+
+    return wrapper;
+}
+
+static void writeJson(const QJsonObject &root)
+{
+    Log::flush();
+    QByteArray json = QJsonDocument(root).toJson(QJsonDocument::Indented);
+    fwrite(json.constData(), 1, json.size(), stdout);
+    fflush(stdout);
+}
+
+static int runBenchmark(const QString &fileName, const BenchmarkOptions &options)
+{
+    QJsonObject root;
+    DSPWrapperPtr wrapper = compileModule(fileName, options.settings, root);
+    if (!wrapper)
+        return kExitFailure;
+
+    dsp *instance = wrapper->getDsp();
+
+    QJsonArray results;
+    double maxLoad = 0;
+
+    for (unsigned sampleRate : options.sampleRates) {
+        instance->init((int)sampleRate);
+
+        size_t length = (size_t)(options.duration * sampleRate);
+        const std::vector<float> signal = generateTestSignal(options.signal, sampleRate, length);
+
+        for (unsigned blockSize : options.blockSizes) {
+            if (length < blockSize)
+                continue;
+
+            instance->instanceClear();
+
+            // skip a tenth of the signal, to warm up the caches
+            size_t skipBlocks = length / blockSize / 10;
+            TimingStats stats = computeTimingStats(measureBlockTimes(instance, signal, blockSize, skipBlocks));
+            double load = stats.mean * 1e-9 * sampleRate;
+            double peakLoad = stats.max * 1e-9 * sampleRate;
+            maxLoad = std::max(maxLoad, load);
+
+            QJsonObject entry;
+            entry["sample-rate"] = (int)sampleRate;
+            entry["block-size"] = (int)blockSize;
+            entry["ns-per-sample"] = stats.mean;
+            entry["ns-per-sample-stddev"] = stats.stddev;
+            entry["ns-per-sample-variance"] = stats.stddev * stats.stddev;
+            entry["ns-per-sample-min"] = stats.min;
+            entry["ns-per-sample-p99"] = stats.p99;
+            entry["real-time-factor"] = load;
+            entry["peak-real-time-factor"] = peakLoad;
+            results.push_back(entry);
+
+            Log::i("%u Hz, %u frames: %.2f ns/sample, load %.4f", sampleRate, blockSize, stats.mean, load);
+        }
+    }
+
+    root["results"] = results;
+    root["max-real-time-factor"] = maxLoad;
+
+    bool overBudget = options.maxLoad > 0 && maxLoad > options.maxLoad;
+    if (options.maxLoad > 0) {
+        root["budget"] = options.maxLoad;
+        root["within-budget"] = !overBudget;
+    }
+
+    writeJson(root);
+
+    return overBudget ? kExitOverBudget : kExitSuccess;
+}
+
+static QJsonObject capacityStepToJson(const CapacityStep &step, double periodTime, size_t instanceSize)
+{
+    QJsonObject obj;
+    obj["instances-per-thread"] = (int)step.instancesPerThread;
+    obj["instances"] = (int)step.numInstances;
+    obj["callback-ns-mean"] = step.callbackTime.mean;
+    obj["callback-ns-p99"] = step.callbackTime.p99;
+    obj["callback-ns-max"] = step.callbackTime.max;
+    obj["load-p99"] = step.callbackTime.p99 / periodTime;
+    obj["ns-per-sample"] = step.nsPerSample;
+    obj["slowdown"] = step.slowdown;
+    obj["working-set"] = (double)(instanceSize * step.numInstances);
+    if (step.perfAvailable) {
+        obj["llc-misses-per-sample"] = step.llcMissesPerSample;
+        obj["memory-bandwidth"] = step.memoryBandwidth;
+    }
+    obj["fits"] = step.fits;
+    return obj;
+}
+
+static int runCapacity(const QString &fileName, const BenchmarkOptions &options)
+{
+    QJsonObject root;
+    DSPWrapperPtr wrapper = compileModule(fileName, options.settings, root);
+    if (!wrapper)
+        return kExitFailure;
+
+    const size_t instanceSize = wrapper->getMemoryFootprint().instanceSize;
+
+    QJsonArray results;
+    for (unsigned sampleRate : options.sampleRates) {
+        for (unsigned blockSize : options.blockSizes) {
+            CapacitySettings settings;
+            settings.sampleRate = sampleRate;
+            settings.blockSize = blockSize;
+            settings.periods = options.periods;
+            settings.maxInstancesPerThread = options.maxInstances;
+            settings.cpus.assign(options.cpus.begin(), options.cpus.end());
+
+            CapacityReport report = measureCapacity(wrapper->getDsp(), settings);
+
+            QJsonObject entry;
+            entry["sample-rate"] = (int)sampleRate;
+            entry["block-size"] = (int)blockSize;
+            entry["period-ns"] = report.periodTime;
+            QJsonArray cpus;
+            for (int cpu : report.cpus)
+                cpus.push_back(cpu);
+            entry["cpus"] = cpus;
+            entry["llc-size"] = (double)report.llcSize;
+            entry["baseline"] = capacityStepToJson(report.baseline, report.periodTime, instanceSize);
+            QJsonArray steps;
+            for (const CapacityStep &step : report.steps)
+                steps.push_back(capacityStepToJson(step, report.periodTime, instanceSize));
+            entry["steps"] = steps;
+            entry["max-instances-per-core"] = (int)report.maxInstancesPerThread;
+            entry["max-instances"] = (int)(report.maxInstancesPerThread * report.cpus.size());
+            results.push_back(entry);
+
+            Log::s("%u Hz, %u frames: %u instances per core", sampleRate, blockSize, report.maxInstancesPerThread);
+        }
+    }
+
+    root["results"] = results;
+    writeJson(root);
+
+    return kExitSuccess;
+}
+
+static QJsonObject renderErrorToJson(const RenderError &error)
+{
+    QJsonObject obj;
+    obj["max-error"] = error.maxError;
+    obj["rms-error"] = error.rmsError();
+    // null if the outputs are identical
+    double snr = error.snr();
+    obj["snr-db"] = std::isinf(snr) ? QJsonValue() : QJsonValue(snr);
+    return obj;
+}
+
+// renders the same signal through a double precision reference and the chosen
+// settings, to weigh the accuracy they lose against the time they save
+static int runAccuracy(const QString &fileName, const BenchmarkOptions &options)
+{
+    CompileSettings referenceSettings = options.settings;
+    referenceSettings.faustFloat = kCompilerDoubleFloat;
+    referenceSettings.cxxFastMath = false;
+    referenceSettings.faustMathApp = false;
+    referenceSettings.faustVec = false;
+
+    QJsonObject reference;
+    QJsonObject fast;
+    DSPWrapperPtr referenceWrapper = compileModule(fileName, referenceSettings, reference);
+    DSPWrapperPtr fastWrapper = compileModule(fileName, options.settings, fast);
+    if (!referenceWrapper || !fastWrapper)
+        return kExitFailure;
+
+    dsp *referenceDsp = referenceWrapper->getDsp();
+    dsp *fastDsp = fastWrapper->getDsp();
+
+    QJsonArray results;
+    double minSnr = std::numeric_limits<double>::infinity();
+
+    for (unsigned sampleRate : options.sampleRates) {
+        size_t length = (size_t)(options.duration * sampleRate);
+        const std::vector<float> signal = generateTestSignal(options.signal, sampleRate, length);
+
+        for (unsigned blockSize : options.blockSizes) {
+            if (length < blockSize)
+                continue;
+
+            referenceDsp->init((int)sampleRate);
+            fastDsp->init((int)sampleRate);
+            const std::vector<std::vector<float>> referenceOutputs = renderSignal(referenceDsp, signal, blockSize);
+            const std::vector<std::vector<float>> fastOutputs = renderSignal(fastDsp, signal, blockSize);
+
+            RenderError total;
+            QJsonArray channels;
+            for (size_t i = 0, n = std::min(referenceOutputs.size(), fastOutputs.size()); i < n; ++i) {
+                RenderError error = compareRenders(referenceOutputs[i], fastOutputs[i]);
+                total.add(error);
+                channels.push_back(renderErrorToJson(error));
+            }
+            minSnr = std::min(minSnr, total.snr());
+
+            referenceDsp->instanceClear();
+            fastDsp->instanceClear();
+            // skip a tenth of the signal, to warm up the caches
+            size_t skipBlocks = length / blockSize / 10;
+            TimingStats referenceTime = computeTimingStats(measureBlockTimes(referenceDsp, signal, blockSize, skipBlocks));
+            TimingStats fastTime = computeTimingStats(measureBlockTimes(fastDsp, signal, blockSize, skipBlocks));
+            double speedup = (fastTime.mean > 0) ? (referenceTime.mean / fastTime.mean) : 0.0;
+
+            QJsonObject entry = renderErrorToJson(total);
+            entry["sample-rate"] = (int)sampleRate;
+            entry["block-size"] = (int)blockSize;
+            entry["channels"] = channels;
+            entry["reference-ns-per-sample"] = referenceTime.mean;
+            entry["fast-ns-per-sample"] = fastTime.mean;
+            entry["speedup"] = speedup;
+            results.push_back(entry);
+
+            Log::i("%u Hz, %u frames: max error %g, SNR %.1f dB, speedup %.2f",
+                   sampleRate, blockSize, total.maxError, total.snr(), speedup);
+        }
+    }
+
+    QJsonObject root;
+    root["file"] = fileName;
+    root["reference"] = reference;
+    root["fast"] = fast;
+    root["results"] = results;
+
+    bool overBudget = minSnr < options.minSnr;
+    if (!std::isinf(options.minSnr)) {
+        root["min-snr-db"] = options.minSnr;
+        root["within-budget"] = !overBudget;
+    }
+
+    writeJson(root);
+
+    return overBudget ? kExitOverBudget : kExitSuccess;
+}
+
+// swaps delay lines while a sine wave runs through the null backend; each one
+// starts silent after its init, then must continue the sine exactly in phase
+static int runSwapTest(const BenchmarkOptions &options)
+{
+    const QByteArray source = QString("process = @(%1);\n").arg(kSwapTestDelay).toUtf8();
+    const QDir cacheDir(DSPWrapper::getCacheDirectory());
+
+    DSPWrapperPtr modules[2];
+    for (int i = 0; i < 2; ++i) {
+        const QString fileName = cacheDir.filePath(QString("swap-test-%1.dsp").arg(i));
+        {
+            QFile file(fileName);
+            if (!file.open(QFile::WriteOnly) || file.write(source) != source.size()) {
+                Log::e("Cannot write %s", fileName.toUtf8().constData());
+                return kExitFailure;
+            }
+        }
+        CompileRequest request;
+        request.fileName = fileName;
+        request.settings = options.settings;
+        modules[i] = DSPWrapper::compile(request).dspWrapper;
+        if (!modules[i])
+            return kExitFailure;
+    }
+
+    NullBackend::Settings backendSettings = NullBackend::getSettingsFromEnvironment();
+    backendSettings.freerun = false;
+    const double periodTime = 1e9 * backendSettings.period / backendSettings.sampleRate;
+
+    const double duration = 1e-3 * options.swapInterval * (options.swaps + 1) + 1.0;
+    ContinuityProbe probe(backendSettings.sampleRate, 441.0, (size_t)(duration * backendSettings.sampleRate), kSwapTestDelay);
+
+    std::unique_ptr<NullBackend> backend(new NullBackend(backendSettings));
+    backend->setInputGenerator(
+        [&probe](float **channels, unsigned numChannels, unsigned nframes) { probe.generate(channels, numChannels, nframes); });
+    backend->setOutputCapture(
+        [&probe](float **channels, unsigned numChannels, unsigned nframes) { probe.capture(channels, numChannels, nframes); });
+
+    CallbackStats stats;
+    {
+        Client client;
+        client.setBackend(std::move(backend));
+        client.setDsp(modules[0]);
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        const CallbackStats statsBefore = client.getCallbackStats();
+        probe.setCapturing(true);
+
+        for (unsigned i = 0; i < options.swaps; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(options.swapInterval));
+            client.setDsp(modules[(i + 1) % 2]);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(options.swapInterval));
+
+        probe.setCapturing(false);
+        stats = client.getCallbackStats();
+        stats.xruns -= statsBefore.xruns;
+    }
+
+    const ContinuityReport report = probe.analyze(periodTime);
+
+    bool passed = report.samples > 0 && !report.overflow &&
+        report.discontinuities == 0 && report.zeroRuns == 0 && report.gaps == 0 &&
+        report.restarts == options.swaps &&
+        (stats.xruns == 0 || options.allowXruns);
+
+    QJsonObject root;
+    root["swaps"] = (int)options.swaps;
+    root["swap-interval-ms"] = (int)options.swapInterval;
+    root["sample-rate"] = (int)backendSettings.sampleRate;
+    root["period"] = (int)backendSettings.period;
+    root["samples"] = (double)report.samples;
+    root["blocks"] = (double)report.blocks;
+    root["overflow"] = report.overflow;
+    root["discontinuities"] = (double)report.discontinuities;
+    root["discontinuity-energy"] = report.discontinuityEnergy;
+    root["zero-runs"] = (double)report.zeroRuns;
+    root["longest-zero-run"] = (double)report.longestZeroRun;
+    root["gaps"] = (double)report.gaps;
+    root["max-block-interval-ns"] = report.maxBlockInterval;
+    root["delay"] = (int)kSwapTestDelay;
+    root["restarts"] = (double)report.restarts;
+    root["xruns"] = (double)stats.xruns;
+    root["passed"] = passed;
+
+    if (passed)
+        Log::s("Hot swap test passed");
+    else
+        Log::e("Hot swap test failed");
+
+    writeJson(root);
+
+    return passed ? kExitSuccess : kExitFailure;
+}
+
+///
+static int runBuild(const QString &fileName, const QString &outputName, const BenchmarkOptions &options)
+{
+    QJsonObject root;
+    DSPWrapperPtr wrapper = compileModule(fileName, options.settings, root, true);
+    if (!wrapper)
+        return kExitFailure;
+
+    if (!writeModuleFile(outputName, wrapper, fileName, options.settings))
+        return kExitFailure;
+
+    root["output"] = outputName;
+    root["isa"] = wrapper->getFingerprint().isa;
+    writeJson(root);
+    return kExitSuccess;
+}
+
+///
+int headlessMain(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("jest");
+    app.setApplicationVersion(JEST_VERSION);
+
+    QCommandLineParser clp;
+    clp.setApplicationDescription("Jest headless mode");
+    clp.addHelpOption();
+
+    const QCommandLineOption benchOption("bench", "Measure the cost of the DSP in <file>.", "file");
+    clp.addOption(benchOption);
+    const QCommandLineOption capacityOption("capacity", "Find how many instances of the DSP in <file> fit on each core.", "file");
+    clp.addOption(capacityOption);
+    const QCommandLineOption settingsOption("settings", "Compile settings, as JSON text or file.", "json");
+    clp.addOption(settingsOption);
+    const QCommandLineOption blockSizesOption("block-sizes", "Comma-separated list of block sizes.", "list");
+    clp.addOption(blockSizesOption);
+    const QCommandLineOption sampleRatesOption("sample-rates", "Comma-separated list of sample rates.", "list");
+    clp.addOption(sampleRatesOption);
+    const QCommandLineOption durationOption("duration", "Seconds of signal processed per configuration.", "seconds");
+    clp.addOption(durationOption);
+    const QCommandLineOption signalOption("signal", "Test signal: noise, sine, impulse or silence.", "name");
+    clp.addOption(signalOption);
+    const QCommandLineOption maxLoadOption("max-load", "Fail if the real-time factor exceeds this ratio.", "ratio");
+    clp.addOption(maxLoadOption);
+    const QCommandLineOption cpusOption("cpus", "Comma-separated list of the CPUs to run on, one thread each.", "list");
+    clp.addOption(cpusOption);
+    const QCommandLineOption periodsOption("periods", "Number of periods measured per step of the capacity search.", "count");
+    clp.addOption(periodsOption);
+    const QCommandLineOption maxInstancesOption("max-instances", "Maximum number of instances per core.", "count");
+    clp.addOption(maxInstancesOption);
+    const QCommandLineOption swapTestOption("swap-test", "Check that swapping modules does not interrupt the audio.");
+    clp.addOption(swapTestOption);
+    const QCommandLineOption swapsOption("swaps", "Number of module swaps.", "count");
+    clp.addOption(swapsOption);
+    const QCommandLineOption swapIntervalOption("swap-interval", "Milliseconds between module swaps.", "ms");
+    clp.addOption(swapIntervalOption);
+    const QCommandLineOption allowXrunsOption("allow-xruns", "Do not fail the swap test on xruns.");
+    clp.addOption(allowXrunsOption);
+    const QCommandLineOption accuracyOption("accuracy", "Compare the DSP in <file> with a double precision reference, without fast math.", "file");
+    clp.addOption(accuracyOption);
+    const QCommandLineOption minSnrOption("min-snr", "Fail if the signal to error ratio is below this level.", "dB");
+    clp.addOption(minSnrOption);
+    const QCommandLineOption buildOption("build", "Compile <file> into a module which loads without compiling.", "file");
+    clp.addOption(buildOption);
+    const QCommandLineOption outputOption(QStringList{"o", "output"}, "The module file to write.", "file");
+    clp.addOption(outputOption);
+
+    clp.process(app);
+
+    BenchmarkOptions options;
+    if (clp.isSet(capacityOption) || clp.isSet(accuracyOption))
+        options.blockSizes = {256};
+    if (clp.isSet(settingsOption) && !parseSettings(clp.value(settingsOption), &options.settings))
+        return kExitUsage;
+    if (clp.isSet(blockSizesOption) && !parseUnsignedList(clp.value(blockSizesOption), &options.blockSizes)) {
+        Log::e("Invalid block sizes");
+        return kExitUsage;
+    }
+    if (clp.isSet(sampleRatesOption) && !parseUnsignedList(clp.value(sampleRatesOption), &options.sampleRates)) {
+        Log::e("Invalid sample rates");
+        return kExitUsage;
+    }
+    if (clp.isSet(durationOption)) {
+        options.duration = clp.value(durationOption).toDouble();
+        if (!(options.duration > 0)) {
+            Log::e("Invalid duration");
+            return kExitUsage;
+        }
+    }
+    if (clp.isSet(signalOption) && !testSignalFromName(clp.value(signalOption).toStdString(), &options.signal)) {
+        Log::e("Invalid test signal");
+        return kExitUsage;
+    }
+    if (clp.isSet(maxLoadOption))
+        options.maxLoad = clp.value(maxLoadOption).toDouble();
+    if (clp.isSet(cpusOption)) {
+        // unlike the other lists, CPU 0 is a valid entry
+        for (const QString &item : clp.value(cpusOption).split(',', Qt::SkipEmptyParts)) {
+            bool ok = false;
+            unsigned cpu = item.trimmed().toUInt(&ok);
+            if (!ok) {
+                Log::e("Invalid CPU list");
+                return kExitUsage;
+            }
+            options.cpus.push_back(cpu);
+        }
+    }
+    if (clp.isSet(periodsOption)) {
+        options.periods = clp.value(periodsOption).toUInt();
+        if (options.periods == 0) {
+            Log::e("Invalid number of periods");
+            return kExitUsage;
+        }
+    }
+    if (clp.isSet(swapsOption))
+        options.swaps = clp.value(swapsOption).toUInt();
+    if (clp.isSet(swapIntervalOption))
+        options.swapInterval = clp.value(swapIntervalOption).toUInt();
+    if (clp.isSet(allowXrunsOption))
+        options.allowXruns = true;
+    if (clp.isSet(minSnrOption)) {
+        bool ok = false;
+        options.minSnr = clp.value(minSnrOption).toDouble(&ok);
+        if (!ok) {
+            Log::e("Invalid signal to error ratio");
+            return kExitUsage;
+        }
+    }
+    if (clp.isSet(maxInstancesOption)) {
+        options.maxInstances = clp.value(maxInstancesOption).toUInt();
+        if (options.maxInstances == 0) {
+            Log::e("Invalid number of instances");
+            return kExitUsage;
+        }
+    }
+
+    QString outputName;
+    if (clp.isSet(buildOption)) {
+        outputName = clp.value(outputOption);
+        if (outputName.isEmpty())
+            outputName = QFileInfo(clp.value(buildOption)).completeBaseName() + ".jestmod";
+    }
+
+    DSPWrapper::setupCacheDirectory();
+
+    int ret = kExitUsage;
+    if (clp.isSet(benchOption))
+        ret = runBenchmark(clp.value(benchOption), options);
+    else if (clp.isSet(capacityOption))
+        ret = runCapacity(clp.value(capacityOption), options);
+    else if (clp.isSet(swapTestOption))
+        ret = runSwapTest(options);
+    else if (clp.isSet(buildOption))
+        ret = runBuild(clp.value(buildOption), outputName, options);
+    else if (clp.isSet(accuracyOption))
+        ret = runAccuracy(clp.value(accuracyOption), options);
+
+    DSPWrapper::cleanupCacheDirectory();
+
+    return ret;
+}
+
+} // namespace jest
@@ -0,0 +1,8 @@
+#pragma once
+
+namespace jest {
+
+bool isHeadlessCommand(int argc, char *argv[]);
+int headlessMain(int argc, char *argv[]);
+
+} // namespace jest
@@ -0,0 +1,186 @@
+#include "jest_jack_backend.h"
+#include "utility/logs.h"
+#include <algorithm>
+
+namespace jest {
+
+JackBackend::~JackBackend()
+{
+    if (jack_client_t *client = _client)
+        jack_client_close(client);
+}
+
+bool JackBackend::open(const std::string &clientName, const AudioCallbacks &callbacks)
+{
+    Log::i("Opening JACK client");
+
+    jack_client_t *client = jack_client_open(clientName.c_str(), JackNoStartServer, nullptr);
+    if (!client)
+        return false;
+
+    unsigned sampleRate = jack_get_sample_rate(client);
+    Log::s("New JACK client at %u Hz sample rate", sampleRate);
+    _sampleRate = sampleRate;
+    _callbacks = callbacks;
+
+    jack_set_thread_init_callback(client, &threadInit, this);
+    jack_set_process_callback(client, &process, this);
+    jack_set_xrun_callback(client, &xrun, this);
+
+    _client = client;
+    return true;
+}
+
+void JackBackend::activate()
+{
+    if (_active)
+        return;
+
+    jack_activate(_client);
+    _active = true;
+
+    // deactivation has disconnected the ports
+    for (size_t i = 0; i < std::min(_inputs.size(), _inputConnections.size()); ++i)
+        restoreJackConnections(_inputs[i], _inputConnections[i]);
+    for (size_t i = 0; i < std::min(_outputs.size(), _outputConnections.size()); ++i)
+        restoreJackConnections(_outputs[i], _outputConnections[i]);
+}
+
+void JackBackend::deactivate()
+{
+    if (!_active)
+        return;
+
+    size_t numInputs = _inputs.size();
+    size_t numOutputs = _outputs.size();
+    _inputConnections.resize(numInputs);
+    _outputConnections.resize(numOutputs);
+    for (size_t i = 0; i < numInputs; ++i)
+        _inputConnections[i] = saveJackConnections(_inputs[i]);
+    for (size_t i = 0; i < numOutputs; ++i)
+        _outputConnections[i] = saveJackConnections(_outputs[i]);
+
+    jack_deactivate(_client);
+    _active = false;
+}
+
+void JackBackend::setChannelCount(unsigned numInputs, unsigned numOutputs)
+{
+    jack_client_t *client = _client;
+
+    size_t oldInputCount = _inputs.size();
+    size_t oldOutputCount = _outputs.size();
+
+    size_t newInputCount = numInputs;
+    size_t newOutputCount = numOutputs;
+
+    for (size_t i = oldInputCount; i < newInputCount; ++i) {
+        std::string name = "in_" + std::to_string(i + 1);
+        jack_port_t *port = jack_port_register(client, name.c_str(), JACK_DEFAULT_AUDIO_TYPE, JackPortIsInput, 0);
+        if (!port)
+            panic("Could not register JACK input");
+        _inputs.push_back(port);
+    }
+    for (size_t i = oldInputCount; i > newInputCount; --i) {
+        jack_port_t *port = _inputs.back();
+        if (jack_port_unregister(client, port) != 0)
+            panic("Could not unregister JACK input");
+        _inputs.pop_back();
+    }
+
+    for (size_t i = oldOutputCount; i < newOutputCount; ++i) {
+        std::string name = "out_" + std::to_string(i + 1);
+        jack_port_t *port = jack_port_register(client, name.c_str(), JACK_DEFAULT_AUDIO_TYPE, JackPortIsOutput, 0);
+        if (!port)
+            panic("Could not register JACK output");
+        _outputs.push_back(port);
+    }
+    for (size_t i = oldOutputCount; i > newOutputCount; --i) {
+        jack_port_t *port = _outputs.back();
+        if (jack_port_unregister(client, port) != 0)
+            panic("Could not unregister JACK output");
+        _outputs.pop_back();
+    }
+
+    _portBufs.resize(newInputCount + newOutputCount);
+}
+
+std::vector<std::string> JackBackend::saveJackConnections(jack_port_t *port)
+{
+    std::vector<std::string> connections;
+
+    const char **con = jack_port_get_connections(port);
+    if (!con)
+        return connections;
+
+    size_t count;
+    for (count = 0; con[count]; ++count);
+
+    connections.reserve(count);
+    for (size_t i = 0; i < count; ++i)
+        connections.emplace_back(con[i]);
+
+    jack_free(con);
+    return connections;
+}
+
+void JackBackend::restoreJackConnections(jack_port_t *port, const std::vector<std::string> &connections)
+{
+    jack_client_t *client = _client;
+    int flags = jack_port_flags(port);
+
+    const char *src = nullptr;
+    const char *dst = nullptr;
+
+    if (flags & JackPortIsOutput)
+        src = jack_port_name(port);
+    else
+        dst = jack_port_name(port);
+
+    size_t count = connections.size();
+    for (size_t i = 0; i < count; ++i) {
+        if (flags & JackPortIsOutput)
+            dst = connections[i].c_str();
+        else
+            src = connections[i].c_str();
+        jack_connect(client, src, dst);
+    }
+}
+
+void JackBackend::threadInit(void *arg)
+{
+    JackBackend *self = (JackBackend *)arg;
+    if (self->_callbacks.threadInit)
+        self->_callbacks.threadInit(self->_callbacks.arg);
+}
+
+int JackBackend::process(jack_nframes_t nframes, void *arg)
+{
+    JackBackend *self = (JackBackend *)arg;
+
+    size_t numInputs = self->_inputs.size();
+    size_t numOutputs = self->_outputs.size();
+
+    float **inputs = self->_portBufs.data();
+    float **outputs = inputs + numInputs;
+
+    for (size_t i = 0; i < numInputs; ++i) {
+        inputs[i] = (float *)jack_port_get_buffer(self->_inputs[i], nframes);
+    }
+    for (size_t i = 0; i < numOutputs; ++i) {
+        outputs[i] = (float *)jack_port_get_buffer(self->_outputs[i], nframes);
+    }
+
+    self->_callbacks.process(inputs, outputs, nframes, self->_callbacks.arg);
+    return 0;
+}
+
+int JackBackend::xrun(void *arg)
+{
+    JackBackend *self = (JackBackend *)arg;
+    if (self->_callbacks.xrun)
+        self->_callbacks.xrun(self->_callbacks.arg);
+    return 0;
+}
+
+} // namespace jest
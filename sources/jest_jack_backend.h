@@ -0,0 +1,41 @@
+#pragma once
+#include "jest_audio_backend.h"
+#include <jack/jack.h>
+#include <vector>
+
+namespace jest {
+
+class JackBackend : public AudioBackend {
+public:
+    ~JackBackend() override;
+
+    const char *getName() const noexcept override { return "jack"; }
+    bool open(const std::string &clientName, const AudioCallbacks &callbacks) override;
+    unsigned getSampleRate() const noexcept override { return _sampleRate; }
+
+    void activate() override;
+    void deactivate() override;
+    bool isActive() const noexcept override { return _active; }
+    void setChannelCount(unsigned numInputs, unsigned numOutputs) override;
+
+private:
+    std::vector<std::string> saveJackConnections(jack_port_t *port);
+    void restoreJackConnections(jack_port_t *port, const std::vector<std::string> &connections);
+
+    static void threadInit(void *arg);
+    static int process(jack_nframes_t nframes, void *arg);
+    static int xrun(void *arg);
+
+private:
+    jack_client_t *_client = nullptr;
+    AudioCallbacks _callbacks;
+    unsigned _sampleRate = 0;
+    bool _active = false;
+    std::vector<jack_port_t *> _inputs;
+    std::vector<jack_port_t *> _outputs;
+    std::vector<float *> _portBufs;
+    std::vector<std::vector<std::string>> _inputConnections;
+    std::vector<std::vector<std::string>> _outputConnections;
+};
+
+} // namespace jest
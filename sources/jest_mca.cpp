@@ -0,0 +1,189 @@
+#include "jest_mca.h"
+#include "jest_build_process.h"
+#include "utility/logs.h"
+#include <QFile>
+#include <QTextStream>
+#include <QRegularExpression>
+#include <QVector>
+#include <QPair>
+
+namespace jest {
+
+static const QString &getLlvmMcaProgram()
+{
+    static QString file = []() -> QString {
+        const QByteArray data = qgetenv("LLVM_MCA");
+        if (data.isEmpty())
+            return "llvm-mca";
+        return QString::fromUtf8(data);
+    }();
+    return file;
+}
+
+// the assembly of the function `compute(int, ...)`
+static QStringList extractComputeFunction(const QStringList &lines, QString *symbol)
+{
+    static const QRegularExpression reType("^\\s*\\.type\\s+([^,\\s]*7computeEi[^,\\s]*)\\s*,\\s*@function");
+
+    for (int i = 0, n = lines.size(); i < n; ++i) {
+        QRegularExpressionMatch match = reType.match(lines[i]);
+        if (!match.hasMatch())
+            continue;
+
+        QString name = match.captured(1);
+        QStringList body;
+        int j = i + 1;
+        for (; j < n && !lines[j].startsWith(name + ":"); ++j);
+        for (++j; j < n; ++j) {
+            const QString line = lines[j].section('#', 0, 0).trimmed();
+            if (line.startsWith(".size") || line.startsWith(".cfi_endproc"))
+                break;
+            body.push_back(line);
+        }
+
+        *symbol = name;
+        return body;
+    }
+
+    return QStringList();
+}
+
+static bool isLabel(const QString &line)
+{
+    return line.endsWith(':') && !line.contains(' ');
+}
+
+static bool isInstruction(const QString &line)
+{
+    return !line.isEmpty() && !line.startsWith('.') && !line.startsWith('#') && !isLabel(line);
+}
+
+// the innermost loop, recognized as a backward branch, having the most instructions
+static QStringList extractHotLoop(const QStringList &body)
+{
+    static const QRegularExpression reBranch("^j\\w+\\s+(\\S+)");
+
+    QVector<QPair<int, int>> loops;
+    for (int k = 0, n = body.size(); k < n; ++k) {
+        QRegularExpressionMatch match = reBranch.match(body[k]);
+        if (!match.hasMatch())
+            continue;
+        int target = body.indexOf(match.captured(1) + ":");
+        if (target != -1 && target < k)
+            loops.push_back(qMakePair(target, k));
+    }
+
+    int best = -1;
+    int bestCount = 0;
+    for (int i = 0, n = loops.size(); i < n; ++i) {
+        bool innermost = true;
+        for (int j = 0; j < n && innermost; ++j) {
+            innermost = j == i || loops[j].first < loops[i].first || loops[j].second > loops[i].second ||
+                loops[j] == loops[i];
+        }
+        if (!innermost)
+            continue;
+        int count = 0;
+        for (int k = loops[i].first; k <= loops[i].second; ++k)
+            count += isInstruction(body[k]);
+        if (count > bestCount) {
+            best = i;
+            bestCount = count;
+        }
+    }
+
+    QStringList loop;
+    if (best == -1)
+        return loop;
+
+    for (int k = loops[best].first; k <= loops[best].second; ++k) {
+        const QString &line = body[k];
+        if (isInstruction(line) || isLabel(line))
+            loop.push_back(line);
+    }
+    return loop;
+}
+
+QString analyzeThroughput(const QString &cxxProgram, const QStringList &cxxFlags, const QString &cxxFile, const QString &asmFile)
+{
+    {
+        BuildProcess proc(false);
+        proc.setProgram(cxxProgram);
+        QStringList args;
+        args << cxxFlags;
+        args << "-fPIC";
+        args << "-S";
+        args << "-o" << asmFile;
+        args << cxxFile;
+        proc.setArguments(args);
+        Log::i("$ %s %s", proc.program().toUtf8().constData() , proc.arguments().join(' ').toUtf8().constData());
+        proc.start();
+        proc.waitForFinished(-1);
+        if (proc.exitStatus() != QProcess::NormalExit || proc.exitCode() != 0)
+            return "Cannot generate the assembly.\n";
+    }
+
+    QStringList lines;
+    {
+        QFile file(asmFile);
+        if (!file.open(QFile::ReadOnly))
+            return "Cannot read the assembly.\n";
+        QTextStream stream(&file);
+        while (!stream.atEnd())
+            lines.push_back(stream.readLine());
+    }
+    QFile::remove(asmFile);
+
+    QString symbol;
+    const QStringList body = extractComputeFunction(lines, &symbol);
+    if (body.isEmpty())
+        return "No compute() function found in the assembly.\n";
+
+    const QStringList loop = extractHotLoop(body);
+    if (loop.isEmpty())
+        return QString("No loop found in %1.\n").arg(symbol);
+
+    QString mcaOutput;
+    {
+        BuildProcess proc(false);
+        proc.setProgram(getLlvmMcaProgram());
+        QStringList args;
+        args << "-mcpu=native";
+        args << "-iterations=100";
+        args << "-bottleneck-analysis";
+        proc.setArguments(args);
+        proc.start();
+        proc.write((loop.join('\n') + '\n').toUtf8());
+        proc.closeWriteChannel();
+        proc.waitForFinished(-1);
+        if (proc.error() == QProcess::FailedToStart)
+            return QString("Cannot run %1.\n").arg(getLlvmMcaProgram());
+        if (proc.exitStatus() != QProcess::NormalExit || proc.exitCode() != 0)
+            return QString("%1 failed:\n%2").arg(getLlvmMcaProgram()).arg(QString::fromUtf8(proc.readAllStandardError()));
+        mcaOutput = QString::fromUtf8(proc.readAllStandardOutput());
+    }
+
+    ///
+    static const QRegularExpression reIterations("^Iterations:\\s+(\\d+)", QRegularExpression::MultilineOption);
+    static const QRegularExpression reCycles("^Total Cycles:\\s+(\\d+)", QRegularExpression::MultilineOption);
+    static const QRegularExpression reThroughput("^Block RThroughput:\\s+([\\d.]+)", QRegularExpression::MultilineOption);
+
+    double iterations = reIterations.match(mcaOutput).captured(1).toDouble();
+    double cycles = reCycles.match(mcaOutput).captured(1).toDouble();
+    QString throughput = reThroughput.match(mcaOutput).captured(1);
+
+    QString text;
+    QTextStream out(&text);
+    out << "Function: " << symbol << "\n";
+    out << "Hot loop: " << loop.size() << " lines\n";
+    if (iterations > 0)
+        out << "Estimated cycles per iteration: " << QString::number(cycles / iterations, 'f', 2) << "\n";
+    if (!throughput.isEmpty())
+        out << "Block reciprocal throughput: " << throughput << "\n";
+    out << "\n" << mcaOutput;
+    out << "\nLoop\n" << loop.join('\n') << "\n";
+    out.flush();
+    return text;
+}
+
+} // namespace jest
@@ -0,0 +1,9 @@
+#pragma once
+#include <QString>
+#include <QStringList>
+
+namespace jest {
+
+QString analyzeThroughput(const QString &cxxProgram, const QStringList &cxxFlags, const QString &cxxFile, const QString &asmFile);
+
+} // namespace jest
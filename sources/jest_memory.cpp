@@ -0,0 +1,89 @@
+#include "jest_memory.h"
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
+#include <cinttypes>
+
+namespace jest {
+
+int64_t getResidentSetSize()
+{
+    FILE *stream = fopen("/proc/self/statm", "r");
+    if (!stream)
+        return 0;
+
+    unsigned long size = 0;
+    unsigned long resident = 0;
+    if (fscanf(stream, "%lu %lu", &size, &resident) != 2)
+        resident = 0;
+    fclose(stream);
+
+    return (int64_t)resident * sysconf(_SC_PAGESIZE);
+}
+
+MappedSizes getMappedSizes(const std::string &fileName)
+{
+    MappedSizes sizes;
+
+    FILE *stream = fopen("/proc/self/maps", "r");
+    if (!stream)
+        return sizes;
+
+    char line[4096];
+    while (fgets(line, sizeof(line), stream)) {
+        uintptr_t start = 0;
+        uintptr_t end = 0;
+        char perms[8] = {};
+        int pathOffset = 0;
+        if (sscanf(line, "%" SCNxPTR "-%" SCNxPTR " %7s %*s %*s %*s %n", &start, &end, perms, &pathOffset) < 3)
+            continue;
+
+        char *path = line + pathOffset;
+        path[strcspn(path, "\n")] = '\0';
+        if (pathOffset == 0 || fileName != path)
+            continue;
+
+        size_t size = end - start;
+        if (perms[2] == 'x')
+            sizes.text += size;
+        else if (perms[1] == 'w')
+            sizes.data += size;
+        else if (perms[0] == 'r')
+            sizes.rodata += size;
+    }
+
+    fclose(stream);
+    return sizes;
+}
+
+bool getThreadPageFaults(int threadId, uint64_t *minor, uint64_t *major)
+{
+    char path[64];
+    sprintf(path, "/proc/self/task/%d/stat", threadId);
+
+    FILE *stream = fopen(path, "r");
+    if (!stream)
+        return false;
+
+    char line[1024];
+    bool valid = fgets(line, sizeof(line), stream) != nullptr;
+    fclose(stream);
+    if (!valid)
+        return false;
+
+    // fields follow the command name, which can contain spaces
+    const char *fields = strrchr(line, ')');
+    if (!fields)
+        return false;
+
+    unsigned long long minflt = 0;
+    unsigned long long majflt = 0;
+    if (sscanf(fields + 1, " %*c %*d %*d %*d %*d %*d %*u %llu %*u %llu", &minflt, &majflt) != 2)
+        return false;
+
+    *minor = minflt;
+    *major = majflt;
+    return true;
+}
+
+} // namespace jest
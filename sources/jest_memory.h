@@ -0,0 +1,24 @@
+#pragma once
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+namespace jest {
+
+struct MappedSizes {
+    size_t text = 0;
+    size_t rodata = 0;
+    size_t data = 0;
+};
+
+struct MemoryFootprint {
+    size_t instanceSize = 0;
+    int64_t loadRssDelta = 0;
+    int64_t initRssDelta = 0;
+};
+
+int64_t getResidentSetSize();
+MappedSizes getMappedSizes(const std::string &fileName);
+bool getThreadPageFaults(int threadId, uint64_t *minor, uint64_t *major);
+
+} // namespace jest
@@ -0,0 +1,316 @@
+#include "jest_metrics.h"
+#include "jest_client.h"
+#include "jest_memory.h"
+#include "utility/logs.h"
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QFileInfo>
+#include <QDir>
+#include <QCoreApplication>
+#include <QTextStream>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QVector>
+#include <QPair>
+#include <algorithm>
+
+namespace jest {
+
+struct MetricsServer::Impl {
+    MetricsServer *_self = nullptr;
+    const Client *_client = nullptr;
+    QLocalServer *_server = nullptr;
+
+    uint64_t _compileSuccesses = 0;
+    uint64_t _compileFailures = 0;
+    uint64_t _sharedCacheHits = 0;
+    uint64_t _sharedCacheMisses = 0;
+    CompileTimings _compileTotal;
+    CompileTimings _compileLast;
+
+    QString _moduleHash;
+    QString _moduleFile;
+
+    uint64_t _reloads = 0;
+    ReloadTimeline _lastReload;
+
+    void serve(QLocalSocket *socket);
+    QVector<QPair<const char *, double>> getReloadPhases() const;
+};
+
+MetricsServer::MetricsServer(const Client &client)
+    : _impl(new Impl)
+{
+    Impl &impl = *_impl;
+    impl._self = this;
+    impl._client = &client;
+}
+
+MetricsServer::~MetricsServer()
+{
+    Impl &impl = *_impl;
+    delete impl._server;
+}
+
+bool MetricsServer::listen(const QString &path)
+{
+    Impl &impl = *_impl;
+
+    QString socketPath = path;
+    if (QFileInfo(socketPath).isDir())
+        socketPath = QDir(socketPath).filePath(QString("jest-%1.sock").arg(QCoreApplication::applicationPid()));
+
+    QLocalServer *server = new QLocalServer;
+    QLocalServer::removeServer(socketPath);
+    if (!server->listen(socketPath)) {
+        Log::e("Cannot listen for metrics on %s", socketPath.toUtf8().constData());
+        delete server;
+        return false;
+    }
+
+    delete impl._server;
+    impl._server = server;
+
+    QObject::connect(
+        server, &QLocalServer::newConnection,
+        server, [&impl, server]() {
+            while (QLocalSocket *socket = server->nextPendingConnection()) {
+                QObject::connect(
+                    socket, &QLocalSocket::readyRead,
+                    socket, [&impl, socket]() { impl.serve(socket); });
+                QObject::connect(socket, &QLocalSocket::disconnected, socket, &QObject::deleteLater);
+            }
+        });
+
+    Log::i("Serving metrics on %s", socketPath.toUtf8().constData());
+    return true;
+}
+
+void MetricsServer::recordCompile(const CompileResult &result)
+{
+    Impl &impl = *_impl;
+
+    if (result.sharedCache == kSharedCacheHit)
+        ++impl._sharedCacheHits;
+    else if (result.sharedCache == kSharedCacheMiss)
+        ++impl._sharedCacheMisses;
+
+    if (!result.dspWrapper) {
+        ++impl._compileFailures;
+        return;
+    }
+
+    ++impl._compileSuccesses;
+    impl._compileLast = result.timings;
+    impl._compileTotal.faust += result.timings.faust;
+    impl._compileTotal.compile += result.timings.compile;
+    impl._compileTotal.link += result.timings.link;
+    impl._compileTotal.load += result.timings.load;
+}
+
+void MetricsServer::recordReload(const ReloadTimeline &timeline)
+{
+    Impl &impl = *_impl;
+    ++impl._reloads;
+    impl._lastReload = timeline;
+}
+
+void MetricsServer::setModule(const QString &hash, const QString &fileName)
+{
+    Impl &impl = *_impl;
+    impl._moduleHash = hash;
+    impl._moduleFile = fileName;
+}
+
+QByteArray MetricsServer::formatText() const
+{
+    Impl &impl = *_impl;
+    const CallbackStats stats = impl._client->getCallbackStats();
+
+    QString text;
+    QTextStream out(&text);
+
+    out << "# HELP jest_callback_load Duration of the audio callback relative to the period.\n";
+    out << "# TYPE jest_callback_load histogram\n";
+    uint64_t cumulative = 0;
+    for (int i = 0; i < kLoadHistogramSize; ++i) {
+        cumulative += stats.loadHistogram[i];
+        QString bound = (i < kLoadHistogramSize - 1) ? QString::number(loadHistogramBounds[i]) : QString("+Inf");
+        out << "jest_callback_load_bucket{le=\"" << bound << "\"} " << cumulative << "\n";
+    }
+    out << "jest_callback_load_sum " << stats.loadSum << "\n";
+    out << "jest_callback_load_count " << stats.callbacks << "\n";
+
+    out << "# HELP jest_xruns_total Count of xruns reported by the audio server.\n";
+    out << "# TYPE jest_xruns_total counter\n";
+    out << "jest_xruns_total " << stats.xruns << "\n";
+
+    out << "# HELP jest_compiles_total Count of module builds.\n";
+    out << "# TYPE jest_compiles_total counter\n";
+    out << "jest_compiles_total{result=\"success\"} " << impl._compileSuccesses << "\n";
+    out << "jest_compiles_total{result=\"failure\"} " << impl._compileFailures << "\n";
+
+    out << "# HELP jest_shared_cache_lookups_total Count of modules looked up in the shared cache.\n";
+    out << "# TYPE jest_shared_cache_lookups_total counter\n";
+    out << "jest_shared_cache_lookups_total{result=\"hit\"} " << impl._sharedCacheHits << "\n";
+    out << "jest_shared_cache_lookups_total{result=\"miss\"} " << impl._sharedCacheMisses << "\n";
+
+    struct Phase { const char *name; double CompileTimings::*field; };
+    static const Phase phases[] = {
+        {"faust", &CompileTimings::faust},
+        {"compile", &CompileTimings::compile},
+        {"link", &CompileTimings::link},
+        {"load", &CompileTimings::load},
+    };
+
+    out << "# HELP jest_compile_seconds_total Time spent building modules, per phase.\n";
+    out << "# TYPE jest_compile_seconds_total counter\n";
+    for (const Phase &phase : phases)
+        out << "jest_compile_seconds_total{phase=\"" << phase.name << "\"} " << impl._compileTotal.*phase.field << "\n";
+
+    out << "# HELP jest_last_compile_seconds Duration of the last successful build, per phase.\n";
+    out << "# TYPE jest_last_compile_seconds gauge\n";
+    for (const Phase &phase : phases)
+        out << "jest_last_compile_seconds{phase=\"" << phase.name << "\"} " << impl._compileLast.*phase.field << "\n";
+
+    out << "# HELP jest_module_info The running module.\n";
+    out << "# TYPE jest_module_info gauge\n";
+    if (!impl._moduleHash.isEmpty()) {
+        QString file = impl._moduleFile;
+        file.replace('\\', "\\\\").replace('"', "\\\"");
+        out << "jest_module_info{hash=\"" << impl._moduleHash << "\",file=\"" << file << "\"} 1\n";
+    }
+
+    out << "# HELP jest_reloads_total Count of modules installed in the client.\n";
+    out << "# TYPE jest_reloads_total counter\n";
+    out << "jest_reloads_total " << impl._reloads << "\n";
+
+    out << "# HELP jest_last_reload_seconds Duration of the last reload, per phase.\n";
+    out << "# TYPE jest_last_reload_seconds gauge\n";
+    for (const QPair<const char *, double> &phase : impl.getReloadPhases())
+        out << "jest_last_reload_seconds{phase=\"" << phase.first << "\"} " << phase.second << "\n";
+
+    out << "# HELP jest_resident_memory_bytes Resident set size of the process.\n";
+    out << "# TYPE jest_resident_memory_bytes gauge\n";
+    out << "jest_resident_memory_bytes " << getResidentSetSize() << "\n";
+
+    out.flush();
+    return text.toUtf8();
+}
+
+QByteArray MetricsServer::formatJson() const
+{
+    Impl &impl = *_impl;
+    const CallbackStats stats = impl._client->getCallbackStats();
+
+    QJsonObject root;
+
+    QJsonObject load;
+    QJsonArray bounds;
+    QJsonArray counts;
+    for (int i = 0; i < kLoadHistogramSize; ++i) {
+        if (i < kLoadHistogramSize - 1)
+            bounds.push_back(loadHistogramBounds[i]);
+        counts.push_back((double)stats.loadHistogram[i]);
+    }
+    load["bounds"] = bounds;
+    load["counts"] = counts;
+    load["sum"] = stats.loadSum;
+    load["count"] = (double)stats.callbacks;
+    root["callback-load"] = load;
+    root["xruns"] = (double)stats.xruns;
+
+    auto timingsToJson = [](const CompileTimings &timings) -> QJsonObject {
+        QJsonObject obj;
+        obj["faust"] = timings.faust;
+        obj["compile"] = timings.compile;
+        obj["link"] = timings.link;
+        obj["load"] = timings.load;
+        return obj;
+    };
+
+    QJsonObject compiles;
+    compiles["successes"] = (double)impl._compileSuccesses;
+    compiles["failures"] = (double)impl._compileFailures;
+    compiles["shared-cache-hits"] = (double)impl._sharedCacheHits;
+    compiles["shared-cache-misses"] = (double)impl._sharedCacheMisses;
+    compiles["total-seconds"] = timingsToJson(impl._compileTotal);
+    compiles["last-seconds"] = timingsToJson(impl._compileLast);
+    root["compiles"] = compiles;
+
+    QJsonObject module;
+    module["hash"] = impl._moduleHash;
+    module["file"] = impl._moduleFile;
+    root["module"] = module;
+
+    const ReloadTimeline &timeline = impl._lastReload;
+    QJsonObject reload;
+    reload["sequence"] = (double)impl._reloads;
+    reload["changed"] = 1e-9 * timeline.changed;
+    reload["requested"] = 1e-9 * timeline.requested;
+    reload["finished"] = 1e-9 * timeline.finished;
+    reload["swapped"] = 1e-9 * timeline.swapped;
+    reload["ready"] = 1e-9 * timeline.ready;
+    reload["first-block"] = 1e-9 * impl._client->getFirstCallbackTime();
+    QJsonObject phases;
+    for (const QPair<const char *, double> &phase : impl.getReloadPhases())
+        phases[phase.first] = phase.second;
+    reload["phases"] = phases;
+    root["last-reload"] = reload;
+
+    root["resident-memory"] = (double)getResidentSetSize();
+
+    return QJsonDocument(root).toJson(QJsonDocument::Indented);
+}
+
+// durations in seconds, of the phases which have completed
+QVector<QPair<const char *, double>> MetricsServer::Impl::getReloadPhases() const
+{
+    QVector<QPair<const char *, double>> phases;
+    const ReloadTimeline &timeline = _lastReload;
+    if (timeline.ready == 0)
+        return phases;
+
+    const CompileTimings &timings = timeline.timings;
+    double build = timings.faust + timings.compile + timings.link + timings.load;
+    phases.push_back(qMakePair("detect", 1e-9 * (timeline.requested - timeline.changed)));
+    phases.push_back(qMakePair("queue", std::max(0.0, 1e-9 * (timeline.finished - timeline.requested) - build)));
+    phases.push_back(qMakePair("faust", timings.faust));
+    phases.push_back(qMakePair("compile", timings.compile));
+    phases.push_back(qMakePair("link", timings.link));
+    phases.push_back(qMakePair("load", timings.load));
+    phases.push_back(qMakePair("swap", 1e-9 * (timeline.swapped - timeline.finished)));
+    phases.push_back(qMakePair("gui", 1e-9 * (timeline.ready - timeline.swapped)));
+
+    uint64_t firstBlock = _client->getFirstCallbackTime();
+    if (firstBlock != 0) {
+        // the audio thread may start before the swap has returned
+        phases.push_back(qMakePair("first-block", std::max(0.0, 1e-9 * ((int64_t)firstBlock - (int64_t)timeline.swapped))));
+        phases.push_back(qMakePair("total", std::max(0.0, 1e-9 * ((int64_t)firstBlock - (int64_t)timeline.changed))));
+    }
+
+    return phases;
+}
+
+void MetricsServer::Impl::serve(QLocalSocket *socket)
+{
+    const QByteArray request = socket->readAll();
+
+    bool http = request.startsWith("GET ");
+    bool json = request.contains("json");
+    const QByteArray body = json ? _self->formatJson() : _self->formatText();
+
+    if (http) {
+        QByteArray header;
+        header += "HTTP/1.0 200 OK\r\n";
+        header += json ? "Content-Type: application/json\r\n" : "Content-Type: text/plain; version=0.0.4\r\n";
+        header += "Content-Length: " + QByteArray::number(body.size()) + "\r\n";
+        header += "\r\n";
+        socket->write(header);
+    }
+    socket->write(body);
+    socket->disconnectFromServer();
+}
+
+} // namespace jest
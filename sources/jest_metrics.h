@@ -0,0 +1,42 @@
+#pragma once
+#include "jest_dsp.h"
+#include <QString>
+#include <QByteArray>
+#include <memory>
+
+namespace jest {
+
+class Client;
+
+// Steps of the reload of a module, in nanoseconds of the monotonic clock.
+struct ReloadTimeline {
+    uint64_t changed = 0; // the modification of the file is noticed
+    uint64_t requested = 0;
+    uint64_t finished = 0; // the compile result reaches the GUI thread
+    uint64_t swapped = 0; // the module is installed in the client
+    uint64_t ready = 0; // the GUI is rebuilt
+    CompileTimings timings;
+};
+
+// Metrics of this instance, served on a local socket as Prometheus text, or
+// as JSON for requests of `/metrics.json`.
+class MetricsServer {
+public:
+    explicit MetricsServer(const Client &client);
+    ~MetricsServer();
+
+    bool listen(const QString &path);
+
+    void recordCompile(const CompileResult &result);
+    void setModule(const QString &hash, const QString &fileName);
+    void recordReload(const ReloadTimeline &timeline);
+
+    QByteArray formatText() const;
+    QByteArray formatJson() const;
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> _impl;
+};
+
+} // namespace jest
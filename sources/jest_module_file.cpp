@@ -0,0 +1,207 @@
+#include "jest_module_file.h"
+#include "utility/logs.h"
+#include <QCryptographicHash>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QtEndian>
+#include <cstring>
+
+namespace jest {
+
+// Layout: magic, header size (32-bit little endian), JSON header, shared object.
+static const char module_file_magic[8] = {'J', 'E', 'S', 'T', 'M', 'O', 'D', '1'};
+
+enum {
+    kModuleHeaderSizeMax = 16 * 1024 * 1024,
+};
+
+static QJsonArray parametersToJson(const std::vector<Parameter> &parameters)
+{
+    QJsonArray array;
+    for (const Parameter &parameter : parameters) {
+        QJsonObject obj;
+        obj["label"] = QString::fromStdString(parameter.label);
+        obj["init"] = parameter.init;
+        obj["min"] = parameter.min;
+        obj["max"] = parameter.max;
+        array.append(obj);
+    }
+    return array;
+}
+
+static std::vector<Parameter> parametersFromJson(const QJsonArray &array)
+{
+    std::vector<Parameter> parameters;
+    parameters.reserve(array.size());
+    for (const QJsonValue &value : array) {
+        QJsonObject obj = value.toObject();
+        Parameter parameter;
+        parameter.label = obj["label"].toString().toStdString();
+        parameter.init = (FAUSTFLOAT)obj["init"].toDouble();
+        parameter.min = (FAUSTFLOAT)obj["min"].toDouble();
+        parameter.max = (FAUSTFLOAT)obj["max"].toDouble();
+        parameters.push_back(parameter);
+    }
+    return parameters;
+}
+
+static bool sameParameters(const std::vector<Parameter> &a, const std::vector<Parameter> &b)
+{
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0, n = a.size(); i < n; ++i) {
+        if (a[i].label != b[i].label || a[i].init != b[i].init || a[i].min != b[i].min || a[i].max != b[i].max)
+            return false;
+    }
+    return true;
+}
+
+bool writeModuleFile(const QString &fileName, const DSPWrapperPtr &wrapper, const QString &sourceName, const CompileSettings &settings)
+{
+    QFile soFile(wrapper->getSoFile());
+    if (!soFile.open(QFile::ReadOnly)) {
+        Log::e("Cannot read the compiled module");
+        return false;
+    }
+    const QByteArray soData = soFile.readAll();
+
+    dsp *instance = wrapper->getDsp();
+    std::vector<Parameter> inputParameters;
+    std::vector<Parameter> outputParameters;
+    collectDspParameters(instance, &inputParameters, &outputParameters);
+
+    const ModuleFingerprint &fingerprint = wrapper->getFingerprint();
+    QJsonObject header;
+    header["source"] = QFileInfo(sourceName).fileName();
+    header["settings"] = compileSettingsToJson(settings).object();
+    header["isa"] = fingerprint.isa;
+    header["source-hash"] = fingerprint.sourceHash;
+    header["toolchain"] = fingerprint.toolchain;
+    header["module-hash"] = wrapper->getModuleHash();
+    header["module-size"] = (double)soData.size();
+    header["inputs"] = instance->getNumInputs();
+    header["outputs"] = instance->getNumOutputs();
+    QJsonObject parameters;
+    parameters["inputs"] = parametersToJson(inputParameters);
+    parameters["outputs"] = parametersToJson(outputParameters);
+    header["parameters"] = parameters;
+
+    const QByteArray headerData = QJsonDocument(header).toJson(QJsonDocument::Compact);
+    uchar headerSize[4];
+    qToLittleEndian<quint32>((quint32)headerData.size(), headerSize);
+
+    QFile file(fileName);
+    if (!file.open(QFile::WriteOnly | QFile::Truncate) ||
+        file.write(module_file_magic, sizeof(module_file_magic)) != sizeof(module_file_magic) ||
+        file.write((const char *)headerSize, sizeof(headerSize)) != sizeof(headerSize) ||
+        file.write(headerData) != headerData.size() ||
+        file.write(soData) != soData.size())
+    {
+        Log::e("Cannot write the module file");
+        file.remove();
+        return false;
+    }
+
+    return true;
+}
+
+DSPWrapperPtr readModuleFile(const QString &fileName, ModuleManifest *manifest)
+{
+    QFile file(fileName);
+    if (!file.open(QFile::ReadOnly)) {
+        Log::e("Cannot open the module file");
+        return nullptr;
+    }
+
+    char magic[sizeof(module_file_magic)];
+    uchar headerSize[4];
+    if (file.read(magic, sizeof(magic)) != sizeof(magic) ||
+        memcmp(magic, module_file_magic, sizeof(magic)) != 0 ||
+        file.read((char *)headerSize, sizeof(headerSize)) != sizeof(headerSize))
+    {
+        Log::e("Not a module file");
+        return nullptr;
+    }
+
+    quint32 headerLength = qFromLittleEndian<quint32>(headerSize);
+    if (headerLength > kModuleHeaderSizeMax) {
+        Log::e("Not a module file");
+        return nullptr;
+    }
+
+    QJsonParseError error;
+    const QJsonDocument doc = QJsonDocument::fromJson(file.read(headerLength), &error);
+    if (!doc.isObject()) {
+        Log::e("Invalid module header: %s", error.errorString().toUtf8().constData());
+        return nullptr;
+    }
+    const QJsonObject header = doc.object();
+
+    ModuleManifest mf;
+    mf.sourceName = header["source"].toString();
+    mf.settings = compileSettingsFromJson(QJsonDocument(header["settings"].toObject()));
+    mf.fingerprint.isa = header["isa"].toString();
+    mf.fingerprint.sourceHash = header["source-hash"].toString();
+    mf.fingerprint.toolchain = header["toolchain"].toString();
+    mf.moduleHash = header["module-hash"].toString();
+    mf.numInputs = header["inputs"].toInt();
+    mf.numOutputs = header["outputs"].toInt();
+    mf.inputParameters = parametersFromJson(header["parameters"].toObject()["inputs"].toArray());
+    mf.outputParameters = parametersFromJson(header["parameters"].toObject()["outputs"].toArray());
+
+    if (mf.fingerprint.isa != DSPWrapper::getIsa()) {
+        Log::e("The module requires %s, this machine is %s",
+               mf.fingerprint.isa.toUtf8().constData(), DSPWrapper::getIsa().toUtf8().constData());
+        return nullptr;
+    }
+
+    const QByteArray soData = file.readAll();
+    if (soData.size() != (qint64)header["module-size"].toDouble()) {
+        Log::e("The module file is truncated");
+        return nullptr;
+    }
+    // checked before anything gets to run from the module
+    if (QString::fromLatin1(QCryptographicHash::hash(soData, QCryptographicHash::Sha1).toHex()) != mf.moduleHash) {
+        Log::e("The module does not match its hash");
+        return nullptr;
+    }
+
+    const QString soFileName = DSPWrapper::makeTemporarySoFile();
+    {
+        QFile soFile(soFileName);
+        if (soFileName.isEmpty() || !soFile.open(QFile::WriteOnly | QFile::Truncate) || soFile.write(soData) != soData.size()) {
+            Log::e("Cannot extract the module");
+            if (!soFileName.isEmpty())
+                QFile::remove(soFileName);
+            return nullptr;
+        }
+    }
+
+    DSPWrapperPtr wrapper = DSPWrapper::load(soFileName, mf.fingerprint);
+    if (!wrapper)
+        return nullptr;
+
+    ///
+    dsp *instance = wrapper->getDsp();
+    if (instance->getNumInputs() != mf.numInputs || instance->getNumOutputs() != mf.numOutputs) {
+        Log::e("The module does not match its channel counts");
+        return nullptr;
+    }
+
+    std::vector<Parameter> inputParameters;
+    std::vector<Parameter> outputParameters;
+    collectDspParameters(instance, &inputParameters, &outputParameters);
+    if (!sameParameters(inputParameters, mf.inputParameters) || !sameParameters(outputParameters, mf.outputParameters)) {
+        Log::e("The module does not match its parameter table");
+        return nullptr;
+    }
+
+    if (manifest)
+        *manifest = std::move(mf);
+    return wrapper;
+}
+
+} // namespace jest
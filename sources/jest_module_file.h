@@ -0,0 +1,25 @@
+#pragma once
+#include "jest_dsp.h"
+#include "jest_parameters.h"
+#include <QString>
+#include <vector>
+
+namespace jest {
+
+// What a module file says about the module it contains.
+struct ModuleManifest {
+    QString sourceName;
+    CompileSettings settings;
+    ModuleFingerprint fingerprint;
+    QString moduleHash;
+    int numInputs = 0;
+    int numOutputs = 0;
+    std::vector<Parameter> inputParameters;
+    std::vector<Parameter> outputParameters;
+};
+
+bool writeModuleFile(const QString &fileName, const DSPWrapperPtr &wrapper, const QString &sourceName, const CompileSettings &settings);
+// loads the module without compiling, after checking it matches its manifest
+DSPWrapperPtr readModuleFile(const QString &fileName, ModuleManifest *manifest);
+
+} // namespace jest
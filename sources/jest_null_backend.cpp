@@ -0,0 +1,131 @@
+#include "jest_null_backend.h"
+#include "utility/logs.h"
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <ctime>
+#include <cerrno>
+
+namespace jest {
+
+NullBackend::NullBackend(const Settings &settings)
+    : _settings(settings)
+{
+}
+
+NullBackend::~NullBackend()
+{
+    deactivate();
+}
+
+NullBackend::Settings NullBackend::getSettingsFromEnvironment()
+{
+    Settings settings;
+
+    if (const char *rate = getenv("JEST_NULL_RATE")) {
+        unsigned value = (unsigned)std::strtoul(rate, nullptr, 10);
+        if (value > 0)
+            settings.sampleRate = value;
+    }
+    if (const char *period = getenv("JEST_NULL_PERIOD")) {
+        unsigned value = (unsigned)std::strtoul(period, nullptr, 10);
+        if (value > 0)
+            settings.period = value;
+    }
+    if (const char *mode = getenv("JEST_NULL_MODE"))
+        settings.freerun = std::strcmp(mode, "freerun") == 0;
+
+    return settings;
+}
+
+bool NullBackend::open(const std::string &clientName, const AudioCallbacks &callbacks)
+{
+    (void)clientName;
+    _callbacks = callbacks;
+    Log::s("Null audio backend at %u Hz sample rate, %u frames per period%s",
+           _settings.sampleRate, _settings.period, _settings.freerun ? ", free-running" : "");
+    return true;
+}
+
+void NullBackend::activate()
+{
+    if (_running.load(std::memory_order_relaxed))
+        return;
+    _running.store(true, std::memory_order_relaxed);
+    _thread = std::thread([this]() { run(); });
+}
+
+void NullBackend::deactivate()
+{
+    if (!_running.load(std::memory_order_relaxed))
+        return;
+    _running.store(false, std::memory_order_relaxed);
+    _thread.join();
+}
+
+void NullBackend::setChannelCount(unsigned numInputs, unsigned numOutputs)
+{
+    _buffers.resize(numInputs + numOutputs);
+    _bufferPointers.resize(numInputs + numOutputs);
+    for (size_t i = 0; i < _buffers.size(); ++i) {
+        _buffers[i].assign(_settings.period, 0.0f);
+        _bufferPointers[i] = _buffers[i].data();
+    }
+    _numInputs = numInputs;
+    _numOutputs = numOutputs;
+}
+
+static uint64_t monotonic_ns() noexcept
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void NullBackend::run()
+{
+    if (_callbacks.threadInit)
+        _callbacks.threadInit(_callbacks.arg);
+
+    const unsigned period = _settings.period;
+    const uint64_t periodTime = (uint64_t)period * 1000000000 / _settings.sampleRate;
+
+    float **inputs = _bufferPointers.data();
+    float **outputs = inputs + _numInputs;
+
+    uint64_t deadline = monotonic_ns() + periodTime;
+
+    while (_running.load(std::memory_order_relaxed)) {
+        if (_inputGenerator)
+            _inputGenerator(inputs, _numInputs, period);
+        else {
+            // the inputs are silent, in case the DSP writes into them
+            for (unsigned i = 0; i < _numInputs; ++i)
+                std::memset(inputs[i], 0, period * sizeof(float));
+        }
+
+        _callbacks.process(inputs, outputs, period, _callbacks.arg);
+
+        if (_outputCapture)
+            _outputCapture(outputs, _numOutputs, period);
+
+        if (_settings.freerun)
+            continue;
+
+        uint64_t now = monotonic_ns();
+        if (now > deadline) {
+            if (_callbacks.xrun)
+                _callbacks.xrun(_callbacks.arg);
+            deadline = now + periodTime;
+            continue;
+        }
+
+        timespec ts;
+        ts.tv_sec = (time_t)(deadline / 1000000000);
+        ts.tv_nsec = (long)(deadline % 1000000000);
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR);
+        deadline += periodTime;
+    }
+}
+
+} // namespace jest
@@ -0,0 +1,56 @@
+#pragma once
+#include "jest_audio_backend.h"
+#include <vector>
+#include <functional>
+#include <thread>
+#include <atomic>
+
+namespace jest {
+
+// A backend without audio device, which runs the processing on its own
+// thread, either in real time at a fixed period, or as fast as possible.
+class NullBackend : public AudioBackend {
+public:
+    struct Settings {
+        unsigned sampleRate = 48000;
+        unsigned period = 256;
+        bool freerun = false;
+    };
+
+    explicit NullBackend(const Settings &settings);
+    ~NullBackend() override;
+
+    static Settings getSettingsFromEnvironment();
+
+    const char *getName() const noexcept override { return "null"; }
+    bool open(const std::string &clientName, const AudioCallbacks &callbacks) override;
+    unsigned getSampleRate() const noexcept override { return _settings.sampleRate; }
+
+    void activate() override;
+    void deactivate() override;
+    bool isActive() const noexcept override { return _running.load(std::memory_order_relaxed); }
+    void setChannelCount(unsigned numInputs, unsigned numOutputs) override;
+
+    // called on the audio thread to fill the inputs, and to receive the
+    // outputs, of each period; set them while inactive
+    using Tap = std::function<void(float **channels, unsigned numChannels, unsigned nframes)>;
+    void setInputGenerator(Tap generator) { _inputGenerator = std::move(generator); }
+    void setOutputCapture(Tap capture) { _outputCapture = std::move(capture); }
+
+private:
+    void run();
+
+private:
+    Settings _settings;
+    AudioCallbacks _callbacks;
+    std::vector<std::vector<float>> _buffers;
+    std::vector<float *> _bufferPointers;
+    unsigned _numInputs = 0;
+    unsigned _numOutputs = 0;
+    Tap _inputGenerator;
+    Tap _outputCapture;
+    std::thread _thread;
+    std::atomic<bool> _running{false};
+};
+
+} // namespace jest
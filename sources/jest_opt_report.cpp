@@ -0,0 +1,179 @@
+#include "jest_opt_report.h"
+#include <QProcess>
+#include <QFile>
+#include <QFileInfo>
+#include <QTextStream>
+#include <QRegularExpression>
+#include <QHash>
+#include <QMap>
+#include <QVector>
+#include <QPair>
+#include <mutex>
+
+namespace jest {
+
+static bool isClangProgram(const QString &program)
+{
+    static std::mutex mutex;
+    static QHash<QString, bool> known;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = known.find(program);
+    if (it != known.end())
+        return *it;
+
+    QProcess proc;
+    proc.start(program, QStringList() << "--version");
+    proc.waitForFinished(-1);
+    bool clang = QString::fromUtf8(proc.readAllStandardOutput()).contains("clang", Qt::CaseInsensitive);
+    known.insert(program, clang);
+    return clang;
+}
+
+QStringList getOptimizationReportFlags(const QString &cxxProgram)
+{
+    QStringList args;
+    if (isClangProgram(cxxProgram)) {
+        args << "-Rpass=loop-vectorize";
+        args << "-Rpass-missed=loop-vectorize";
+        args << "-Rpass-analysis=loop-vectorize";
+    }
+    else
+        args << "-fopt-info-vec-all";
+    return args;
+}
+
+// line ranges of the bodies of `compute(int ...)` functions
+static QVector<QPair<int, int>> findComputeRanges(const QStringList &lines)
+{
+    QVector<QPair<int, int>> ranges;
+    static const QRegularExpression re("\\bcompute\\s*\\(\\s*int\\b");
+
+    for (int i = 0, n = lines.size(); i < n; ++i) {
+        if (!re.match(lines[i]).hasMatch())
+            continue;
+
+        int depth = 0;
+        bool opened = false;
+        int j = i;
+        for (; j < n; ++j) {
+            for (QChar c : lines[j]) {
+                if (c == '{') {
+                    ++depth;
+                    opened = true;
+                }
+                else if (c == '}')
+                    --depth;
+            }
+            if (opened && depth <= 0)
+                break;
+            if (!opened && lines[j].contains(';'))
+                break; // a declaration
+        }
+        if (opened) {
+            ranges.push_back(qMakePair(i + 1, j + 1));
+            i = j;
+        }
+    }
+
+    return ranges;
+}
+
+QString formatOptimizationReport(const QString &diagnostics, const QString &cxxFile)
+{
+    QStringList sourceLines;
+    {
+        QFile file(cxxFile);
+        if (file.open(QFile::ReadOnly)) {
+            QTextStream stream(&file);
+            while (!stream.atEnd())
+                sourceLines.push_back(stream.readLine());
+        }
+    }
+
+    const QVector<QPair<int, int>> computeRanges = findComputeRanges(sourceLines);
+    auto isInCompute = [&computeRanges](int line) -> bool {
+        for (const QPair<int, int> &range : computeRanges) {
+            if (line >= range.first && line <= range.second)
+                return true;
+        }
+        return false;
+    };
+
+    struct Loop {
+        QStringList vectorized;
+        QStringList missed;
+    };
+
+    QMap<int, Loop> loops;
+    int otherVectorized = 0;
+    int otherMissed = 0;
+
+    const QString fileName = QFileInfo(cxxFile).fileName();
+    static const QRegularExpression re(
+        "^(.*):(\\d+):(\\d+): (optimized|missed|remark): (.*?)(?: \\[(-Rpass[^\\]]*)\\])?$");
+
+    for (const QString &diagnostic : diagnostics.split('\n')) {
+        QRegularExpressionMatch match = re.match(diagnostic);
+        if (!match.hasMatch())
+            continue;
+        if (QFileInfo(match.captured(1)).fileName() != fileName)
+            continue;
+
+        int line = match.captured(2).toInt();
+        QString kind = match.captured(4);
+        QString message = match.captured(5);
+        QString pass = match.captured(6);
+
+        bool vectorized = kind == "optimized" ||
+            (kind == "remark" && pass.startsWith("-Rpass="));
+
+        if (!isInCompute(line)) {
+            ++(vectorized ? otherVectorized : otherMissed);
+            continue;
+        }
+
+        Loop &loop = loops[line];
+        QStringList &messages = vectorized ? loop.vectorized : loop.missed;
+        if (!messages.contains(message))
+            messages.push_back(message);
+    }
+
+    ///
+    QString text;
+    QTextStream out(&text);
+
+    int numVectorized = 0;
+    int numMissed = 0;
+    for (const Loop &loop : loops) {
+        if (!loop.vectorized.isEmpty())
+            ++numVectorized;
+        else
+            ++numMissed;
+    }
+
+    out << "Loops of compute(): " << numVectorized << " vectorized, " << numMissed << " missed\n";
+    if (otherVectorized + otherMissed > 0)
+        out << "Outside compute(): " << otherVectorized << " vectorized, " << otherMissed << " missed remarks\n";
+    if (computeRanges.isEmpty())
+        out << "No compute() function found in " << fileName << "\n";
+
+    for (auto it = loops.begin(); it != loops.end(); ++it) {
+        int line = it.key();
+        const Loop &loop = it.value();
+        out << "\n" << QString("%1:%2").arg(fileName).arg(line).leftJustified(20)
+            << (loop.vectorized.isEmpty() ? "missed     " : "vectorized ");
+        if (line > 0 && line <= sourceLines.size())
+            out << "  " << sourceLines[line - 1].trimmed();
+        out << "\n";
+        for (const QString &message : loop.vectorized)
+            out << "    + " << message << "\n";
+        for (const QString &message : loop.missed)
+            out << "    - " << message << "\n";
+    }
+
+    out.flush();
+    return text;
+}
+
+} // namespace jest
@@ -0,0 +1,10 @@
+#pragma once
+#include <QString>
+#include <QStringList>
+
+namespace jest {
+
+QStringList getOptimizationReportFlags(const QString &cxxProgram);
+QString formatOptimizationReport(const QString &diagnostics, const QString &cxxFile);
+
+} // namespace jest
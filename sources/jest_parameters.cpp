@@ -1,5 +1,6 @@
 #include "jest_parameters.h"
 #include <faust/gui/UI.h>
+#include <algorithm>
 
 namespace jest {
 
@@ -59,6 +60,39 @@ public:
     void declare(REAL *, const char *, const char *) override {}
 };
 
+class CurrentValueUI : public UI {
+public:
+    using REAL = FAUSTFLOAT;
+
+    explicit CurrentValueUI(UI *ui) : _ui(ui) {}
+
+    // -- widget's layouts
+    void openTabBox(const char *label) override { _ui->openTabBox(label); }
+    void openHorizontalBox(const char *label) override { _ui->openHorizontalBox(label); }
+    void openVerticalBox(const char *label) override { _ui->openVerticalBox(label); }
+    void closeBox() override { _ui->closeBox(); }
+
+    // -- active widgets
+    void addButton(const char *label, REAL *zone) override { _ui->addButton(label, zone); }
+    void addCheckButton(const char *label, REAL *zone) override { _ui->addCheckButton(label, zone); }
+    void addVerticalSlider(const char *label, REAL *zone, REAL, REAL min, REAL max, REAL step) override { _ui->addVerticalSlider(label, zone, *zone, min, max, step); }
+    void addHorizontalSlider(const char *label, REAL *zone, REAL, REAL min, REAL max, REAL step) override { _ui->addHorizontalSlider(label, zone, *zone, min, max, step); }
+    void addNumEntry(const char *label, REAL *zone, REAL, REAL min, REAL max, REAL step) override { _ui->addNumEntry(label, zone, *zone, min, max, step); }
+
+    // -- passive widgets
+    void addHorizontalBargraph(const char *label, REAL *zone, REAL min, REAL max) override { _ui->addHorizontalBargraph(label, zone, min, max); }
+    void addVerticalBargraph(const char *label, REAL *zone, REAL min, REAL max) override { _ui->addVerticalBargraph(label, zone, min, max); }
+
+    // -- soundfiles
+    void addSoundfile(const char *label, const char *url, Soundfile **sf) override { _ui->addSoundfile(label, url, sf); }
+
+    // -- metadata declarations
+    void declare(REAL *zone, const char *key, const char *val) override { _ui->declare(zone, key, val); }
+
+private:
+    UI *_ui = nullptr;
+};
+
 void collectDspParameters(dsp *dsp, std::vector<Parameter> *inputs, std::vector<Parameter> *outputs)
 {
     ParameterCollector ui;
@@ -67,4 +101,24 @@ void collectDspParameters(dsp *dsp, std::vector<Parameter> *inputs, std::vector<
     dsp->buildUserInterface(&ui);
 }
 
+void setDspControls(dsp *dsp, const float *values, size_t numValues)
+{
+    if (!dsp || numValues == 0)
+        return;
+
+    std::vector<Parameter> inputParameters;
+    collectDspParameters(dsp, &inputParameters, nullptr);
+    for (size_t i = 0; i < numValues && i < inputParameters.size(); ++i) {
+        float lo = inputParameters[i].min;
+        float hi = inputParameters[i].max;
+        *inputParameters[i].zone = std::max(lo, std::min(hi, values[i]));
+    }
+}
+
+void buildDspInterface(dsp *dsp, UI *ui)
+{
+    CurrentValueUI proxy(ui);
+    dsp->buildUserInterface(&proxy);
+}
+
 } // namespace jest
@@ -14,5 +14,10 @@ struct Parameter {
 };
 
 void collectDspParameters(dsp *dsp, std::vector<Parameter> *inputs, std::vector<Parameter> *outputs);
+// writes the input parameters in order, within their ranges
+void setDspControls(dsp *dsp, const float *values, size_t numValues);
+// builds the interface with the current values of the parameters as the initial
+// ones, since the widgets set their parameters as they are created
+void buildDspInterface(dsp *dsp, UI *ui);
 
 } // namespace jest
@@ -0,0 +1,176 @@
+#include "jest_perf_counters.h"
+#include "utility/logs.h"
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <cstring>
+#include <cerrno>
+
+namespace jest {
+
+static int perf_event_open(perf_event_attr *attr, pid_t pid, int cpu, int group_fd, unsigned long flags)
+{
+    return (int)syscall(SYS_perf_event_open, attr, pid, cpu, group_fd, flags);
+}
+
+struct PerfEventType {
+    const char *name;
+    uint32_t type;
+    uint64_t config;
+};
+
+static const PerfEventType perf_event_types[kPerfCounterCount] = {
+    {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {"L1D misses", PERF_TYPE_HW_CACHE,
+     PERF_COUNT_HW_CACHE_L1D |
+     (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+     (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+    {"LLC misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {"branch misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+};
+
+PerfCounters::PerfCounters()
+{
+    for (int i = 0; i < kPerfCounterCount; ++i) {
+        _fds[i] = -1;
+        _totals[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+PerfCounters::~PerfCounters()
+{
+    close();
+}
+
+bool PerfCounters::open()
+{
+    close();
+
+    unsigned mask = 0;
+
+    for (int i = 0; i < kPerfCounterCount; ++i) {
+        const PerfEventType &et = perf_event_types[i];
+
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = et.type;
+        attr.config = et.config;
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_ID;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+
+        int fd = perf_event_open(&attr, 0, -1, _groupFd, 0);
+        if (fd == -1) {
+            RTLog::w("Performance counter unavailable: %s (%s)", et.name, std::strerror(errno));
+            continue;
+        }
+
+        if (ioctl(fd, PERF_EVENT_IOC_ID, &_ids[i]) == -1) {
+            ::close(fd);
+            continue;
+        }
+
+        if (_groupFd == -1)
+            _groupFd = fd;
+        _fds[i] = fd;
+        mask |= 1u << i;
+    }
+
+    _availableMask.store(mask, std::memory_order_relaxed);
+
+    if (_groupFd == -1) {
+        RTLog::w("Performance counters are not permitted, check /proc/sys/kernel/perf_event_paranoid");
+        return false;
+    }
+
+    RTLog::i("Performance counters opened");
+    return true;
+}
+
+void PerfCounters::close()
+{
+    for (int i = 0; i < kPerfCounterCount; ++i) {
+        if (_fds[i] != -1 && _fds[i] != _groupFd)
+            ::close(_fds[i]);
+        _fds[i] = -1;
+    }
+    if (_groupFd != -1) {
+        ::close(_groupFd);
+        _groupFd = -1;
+    }
+    _started = false;
+    _availableMask.store(0, std::memory_order_relaxed);
+}
+
+void PerfCounters::begin() noexcept
+{
+    _started = isOpen() && readGroup(_start);
+}
+
+void PerfCounters::end(uint32_t frames) noexcept
+{
+    if (!_started)
+        return;
+
+    _started = false;
+
+    uint64_t values[kPerfCounterCount];
+    if (!readGroup(values))
+        return;
+
+    for (int i = 0; i < kPerfCounterCount; ++i)
+        _totals[i].fetch_add(values[i] - _start[i], std::memory_order_relaxed);
+    _frames.fetch_add(frames, std::memory_order_relaxed);
+}
+
+PerfCounterValues PerfCounters::getTotals() const noexcept
+{
+    PerfCounterValues totals;
+    for (int i = 0; i < kPerfCounterCount; ++i)
+        totals.counters[i] = _totals[i].load(std::memory_order_relaxed);
+    totals.frames = _frames.load(std::memory_order_relaxed);
+    totals.availableMask = _availableMask.load(std::memory_order_relaxed);
+    return totals;
+}
+
+void PerfCounters::resetTotals() noexcept
+{
+    for (int i = 0; i < kPerfCounterCount; ++i)
+        _totals[i].store(0, std::memory_order_relaxed);
+    _frames.store(0, std::memory_order_relaxed);
+}
+
+bool PerfCounters::readGroup(uint64_t values[kPerfCounterCount]) noexcept
+{
+    // layout of PERF_FORMAT_GROUP|PERF_FORMAT_ID: nr, {value, id}[nr]
+    uint64_t buffer[1 + 2 * kPerfCounterCount];
+
+    ssize_t count = ::read(_groupFd, buffer, sizeof(buffer));
+    if (count < (ssize_t)sizeof(uint64_t))
+        return false;
+
+    uint64_t nr = buffer[0];
+    if (nr > kPerfCounterCount)
+        return false;
+
+    for (int i = 0; i < kPerfCounterCount; ++i)
+        values[i] = 0;
+
+    for (uint64_t j = 0; j < nr; ++j) {
+        uint64_t value = buffer[1 + 2 * j];
+        uint64_t id = buffer[2 + 2 * j];
+        for (int i = 0; i < kPerfCounterCount; ++i) {
+            if (_fds[i] != -1 && _ids[i] == id) {
+                values[i] = value;
+                break;
+            }
+        }
+    }
+
+    return true;
+}
+
+} // namespace jest
@@ -0,0 +1,54 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+namespace jest {
+
+enum PerfCounterId {
+    kPerfCycles,
+    kPerfInstructions,
+    kPerfL1DMisses,
+    kPerfLLCMisses,
+    kPerfBranchMisses,
+    kPerfCounterCount,
+};
+
+struct PerfCounterValues {
+    uint64_t counters[kPerfCounterCount] = {};
+    uint64_t frames = 0;
+    unsigned availableMask = 0;
+};
+
+// Hardware counters of the calling thread, sampled around a section of code.
+// `open`, `begin` and `end` must be called on the measured thread; totals can
+// be read from any thread.
+class PerfCounters {
+public:
+    PerfCounters();
+    ~PerfCounters();
+
+    bool open();
+    void close();
+    bool isOpen() const noexcept { return _groupFd != -1; }
+
+    void begin() noexcept;
+    void end(uint32_t frames) noexcept;
+
+    PerfCounterValues getTotals() const noexcept;
+    void resetTotals() noexcept;
+
+private:
+    bool readGroup(uint64_t values[kPerfCounterCount]) noexcept;
+
+private:
+    int _groupFd = -1;
+    int _fds[kPerfCounterCount];
+    uint64_t _ids[kPerfCounterCount] = {};
+    uint64_t _start[kPerfCounterCount] = {};
+    bool _started = false;
+    std::atomic<unsigned> _availableMask{0};
+    std::atomic<uint64_t> _totals[kPerfCounterCount];
+    std::atomic<uint64_t> _frames{0};
+};
+
+} // namespace jest
@@ -0,0 +1,165 @@
+#include "jest_processor.h"
+#include "jest_parameters.h"
+#include "jest_trace.h"
+#include <faust/dsp/dsp.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <cstring>
+#include <ctime>
+
+namespace jest {
+
+enum {
+    // the largest period of the comparison, beyond which only A runs
+    kComparisonMaxFrames = 8192,
+};
+
+const double loadHistogramBounds[kLoadHistogramSize - 1] = {0.1, 0.25, 0.5, 0.75, 0.9, 1.0};
+
+static uint64_t monotonic_ns() noexcept
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+Processor::Processor()
+{
+    for (std::atomic<uint64_t> &count : _loadHistogram)
+        count.store(0, std::memory_order_relaxed);
+}
+
+void Processor::setDsp(dsp *dsp)
+{
+    _perfCounters.resetTotals();
+    _firstCallbackTime.store(0, std::memory_order_relaxed);
+    _dsp.store(dsp, std::memory_order_release);
+}
+
+bool Processor::waitForCallbacks(unsigned count, unsigned timeoutMs) const
+{
+    uint64_t target = _callbacks.load(std::memory_order_acquire) + count;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    while (_callbacks.load(std::memory_order_acquire) < target) {
+        if (std::chrono::steady_clock::now() > deadline)
+            return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+void Processor::setControls(const float *initialValues, size_t numInitialValues)
+{
+    setDspControls(getDsp(), initialValues, numInitialValues);
+}
+
+void Processor::setComparisonDsp(dsp *dsp)
+{
+    if (dsp) {
+        unsigned numOutputs = dsp->getNumOutputs();
+        _comparisonBuffer.assign((size_t)numOutputs * kComparisonMaxFrames, 0.0f);
+        _comparisonOutputs.resize(numOutputs);
+        for (unsigned i = 0; i < numOutputs; ++i)
+            _comparisonOutputs[i] = &_comparisonBuffer[(size_t)i * kComparisonMaxFrames];
+    }
+
+    _comparisonBlocks.store(0, std::memory_order_relaxed);
+    _comparisonFrames.store(0, std::memory_order_relaxed);
+    _comparisonTimeA.store(0, std::memory_order_relaxed);
+    _comparisonTimeB.store(0, std::memory_order_relaxed);
+    _comparisonDsp.store(dsp, std::memory_order_release);
+}
+
+ComparisonStats Processor::getComparisonStats() const noexcept
+{
+    ComparisonStats stats;
+    stats.blocks = _comparisonBlocks.load(std::memory_order_relaxed);
+    stats.frames = _comparisonFrames.load(std::memory_order_relaxed);
+    stats.timeA = 1e-9 * _comparisonTimeA.load(std::memory_order_relaxed);
+    stats.timeB = 1e-9 * _comparisonTimeB.load(std::memory_order_relaxed);
+    return stats;
+}
+
+CallbackStats Processor::getCallbackStats() const noexcept
+{
+    CallbackStats stats;
+    stats.callbacks = _callbacks.load(std::memory_order_relaxed);
+    stats.xruns = _xruns.load(std::memory_order_relaxed);
+    for (int i = 0; i < kLoadHistogramSize; ++i)
+        stats.loadHistogram[i] = _loadHistogram[i].load(std::memory_order_relaxed);
+    stats.loadSum = 1e-6 * _loadSumPpm.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void Processor::process(float **inputs, float **outputs, unsigned numOutputs, unsigned nframes) noexcept
+{
+    uint64_t startTime = monotonic_ns();
+
+    dsp *dsp = _dsp.load(std::memory_order_acquire);
+
+    if (dsp) {
+        bool firstCallback = dsp != _lastProcessedDsp;
+        _lastProcessedDsp = dsp;
+        if (firstCallback) {
+            _firstCallbackTime.store(startTime, std::memory_order_relaxed);
+            Trace::begin("first callback");
+        }
+        ::dsp *comparisonDsp = _comparisonDsp.load(std::memory_order_acquire);
+        if (comparisonDsp && nframes <= kComparisonMaxFrames)
+            processComparison(dsp, comparisonDsp, inputs, outputs, numOutputs, nframes);
+        else {
+            _perfCounters.begin();
+            dsp->compute((int)nframes, inputs, outputs);
+            _perfCounters.end(nframes);
+        }
+        if (firstCallback)
+            Trace::end("first callback");
+    }
+    else {
+        for (unsigned i = 0; i < numOutputs; ++i)
+            std::memset(outputs[i], 0, nframes * sizeof(float));
+    }
+
+    double load = (monotonic_ns() - startTime) * 1e-9 * _sampleRate / nframes;
+    int bucket = 0;
+    while (bucket < kLoadHistogramSize - 1 && load > loadHistogramBounds[bucket])
+        ++bucket;
+    _loadHistogram[bucket].fetch_add(1, std::memory_order_relaxed);
+    _loadSumPpm.fetch_add((uint64_t)(load * 1e6), std::memory_order_relaxed);
+    _callbacks.fetch_add(1, std::memory_order_release);
+}
+
+// both modules compute every block, the one not heard goes to the scratch buffer
+void Processor::processComparison(dsp *dspA, dsp *dspB, float **inputs, float **outputs, unsigned numOutputs, unsigned nframes) noexcept
+{
+    int mode = _comparisonMode.load(std::memory_order_relaxed);
+    float **scratch = _comparisonOutputs.data();
+    float **outputsA = (mode == kComparisonListenB) ? scratch : outputs;
+    float **outputsB = (mode == kComparisonListenB) ? outputs : scratch;
+
+    uint64_t t0 = monotonic_ns();
+    _perfCounters.begin();
+    dspA->compute((int)nframes, inputs, outputsA);
+    _perfCounters.end(nframes);
+    uint64_t t1 = monotonic_ns();
+    dspB->compute((int)nframes, inputs, outputsB);
+    uint64_t t2 = monotonic_ns();
+
+    if (mode == kComparisonNull) {
+        for (unsigned i = 0; i < numOutputs; ++i) {
+            float *out = outputs[i];
+            const float *other = scratch[i];
+            for (unsigned j = 0; j < nframes; ++j)
+                out[j] -= other[j];
+        }
+    }
+
+    _comparisonTimeA.fetch_add(t1 - t0, std::memory_order_relaxed);
+    _comparisonTimeB.fetch_add(t2 - t1, std::memory_order_relaxed);
+    _comparisonFrames.fetch_add(nframes, std::memory_order_relaxed);
+    _comparisonBlocks.fetch_add(1, std::memory_order_relaxed);
+}
+
+} // namespace jest
@@ -0,0 +1,91 @@
+#pragma once
+#include "jest_perf_counters.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+class dsp;
+
+namespace jest {
+
+enum { kLoadHistogramSize = 7 };
+extern const double loadHistogramBounds[kLoadHistogramSize - 1];
+
+struct CallbackStats {
+    uint64_t callbacks = 0;
+    uint64_t xruns = 0;
+    uint64_t loadHistogram[kLoadHistogramSize] = {};
+    double loadSum = 0;
+};
+
+enum ComparisonMode {
+    kComparisonListenA,
+    kComparisonListenB,
+    // the difference of the outputs, silent when both modules agree
+    kComparisonNull,
+};
+
+struct ComparisonStats {
+    uint64_t blocks = 0;
+    uint64_t frames = 0;
+    double timeA = 0;
+    double timeB = 0;
+};
+
+// The audio side of the client, independent of the audio driver.
+class Processor {
+public:
+    Processor();
+
+    // the previous DSP may still be in use until the next callback has ended,
+    // see `waitForCallbacks`
+    void setDsp(dsp *dsp);
+    dsp *getDsp() const noexcept { return _dsp.load(std::memory_order_acquire); }
+    bool waitForCallbacks(unsigned count, unsigned timeoutMs) const;
+    void setSampleRate(unsigned sampleRate) { _sampleRate = sampleRate; }
+    unsigned getSampleRate() const noexcept { return _sampleRate; }
+
+    void setControls(const float *initialValues, size_t numInitialValues);
+
+    // a second DSP, with the same channels, fed the same input; it must be
+    // unset, and the callbacks waited for, before another one is set
+    void setComparisonDsp(dsp *dsp);
+    dsp *getComparisonDsp() const noexcept { return _comparisonDsp.load(std::memory_order_acquire); }
+    void setComparisonMode(int mode) noexcept { _comparisonMode.store(mode, std::memory_order_relaxed); }
+    ComparisonStats getComparisonStats() const noexcept;
+
+    void process(float **inputs, float **outputs, unsigned numOutputs, unsigned nframes) noexcept;
+    void countXrun() noexcept { _xruns.fetch_add(1, std::memory_order_relaxed); }
+
+    PerfCounters &getPerfCounters() noexcept { return _perfCounters; }
+    const PerfCounters &getPerfCounters() const noexcept { return _perfCounters; }
+    CallbackStats getCallbackStats() const noexcept;
+    // the time of the first callback since the last change of DSP, or 0
+    uint64_t getFirstCallbackTime() const noexcept { return _firstCallbackTime.load(std::memory_order_relaxed); }
+
+private:
+    void processComparison(dsp *dspA, dsp *dspB, float **inputs, float **outputs, unsigned numOutputs, unsigned nframes) noexcept;
+
+private:
+    std::atomic<dsp *> _dsp{nullptr};
+    dsp *_lastProcessedDsp = nullptr;
+    unsigned _sampleRate = 0;
+    PerfCounters _perfCounters;
+
+    std::atomic<uint64_t> _callbacks{0};
+    std::atomic<uint64_t> _xruns{0};
+    std::atomic<uint64_t> _loadHistogram[kLoadHistogramSize];
+    std::atomic<uint64_t> _loadSumPpm{0};
+    std::atomic<uint64_t> _firstCallbackTime{0};
+
+    std::atomic<dsp *> _comparisonDsp{nullptr};
+    std::atomic<int> _comparisonMode{kComparisonListenA};
+    std::vector<float> _comparisonBuffer;
+    std::vector<float *> _comparisonOutputs;
+    std::atomic<uint64_t> _comparisonBlocks{0};
+    std::atomic<uint64_t> _comparisonFrames{0};
+    std::atomic<uint64_t> _comparisonTimeA{0};
+    std::atomic<uint64_t> _comparisonTimeB{0};
+};
+
+} // namespace jest
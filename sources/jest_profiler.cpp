@@ -0,0 +1,287 @@
+#include "jest_profiler.h"
+#include "utility/logs.h"
+#include <QProcess>
+#include <QFile>
+#include <QFileInfo>
+#include <QTextStream>
+#include <QVector>
+#include <QHash>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+
+namespace jest {
+
+static int perf_event_open(perf_event_attr *attr, pid_t pid, int cpu, int group_fd, unsigned long flags)
+{
+    return (int)syscall(SYS_perf_event_open, attr, pid, cpu, group_fd, flags);
+}
+
+static const QString &getAddr2LineProgram()
+{
+    static QString file = []() -> QString {
+        const QByteArray data = qgetenv("ADDR2LINE");
+        if (data.isEmpty())
+            return "addr2line";
+        return QString::fromUtf8(data);
+    }();
+    return file;
+}
+
+enum { kProfilerRingPages = 64 };
+
+Profiler::Profiler()
+{
+}
+
+Profiler::~Profiler()
+{
+    stop();
+}
+
+bool Profiler::start(int threadId, unsigned frequency)
+{
+    stop();
+
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_CPU_CYCLES;
+    attr.freq = 1;
+    attr.sample_freq = frequency;
+    attr.sample_type = PERF_SAMPLE_IP;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    int fd = perf_event_open(&attr, threadId, -1, -1, 0);
+    if (fd == -1) {
+        // no hardware PMU, as in most virtual machines
+        attr.type = PERF_TYPE_SOFTWARE;
+        attr.config = PERF_COUNT_SW_CPU_CLOCK;
+        fd = perf_event_open(&attr, threadId, -1, -1, 0);
+    }
+    if (fd == -1) {
+        Log::w("Cannot sample the audio thread: %s", std::strerror(errno));
+        return false;
+    }
+
+    size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    size_t ringSize = (1 + kProfilerRingPages) * pageSize;
+    void *ring = mmap(nullptr, ringSize, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+    if (ring == MAP_FAILED) {
+        Log::w("Cannot map the sample buffer: %s", std::strerror(errno));
+        close(fd);
+        return false;
+    }
+
+    _fd = fd;
+    _threadId = threadId;
+    _ring = ring;
+    _ringSize = ringSize;
+
+    Log::i("Profiling thread %d at %u Hz", threadId, frequency);
+    return true;
+}
+
+void Profiler::stop()
+{
+    if (_ring) {
+        munmap(_ring, _ringSize);
+        _ring = nullptr;
+        _ringSize = 0;
+    }
+    if (_fd != -1) {
+        close(_fd);
+        _fd = -1;
+    }
+    _threadId = -1;
+}
+
+void Profiler::collect()
+{
+    if (!_ring)
+        return;
+
+    size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    perf_event_mmap_page *meta = (perf_event_mmap_page *)_ring;
+    const uint8_t *data = (const uint8_t *)_ring + pageSize;
+    size_t dataSize = _ringSize - pageSize;
+
+    auto copyOut = [data, dataSize](void *dst, uint64_t offset, size_t size) {
+        for (size_t i = 0; i < size; ++i)
+            ((uint8_t *)dst)[i] = data[(offset + i) % dataSize];
+    };
+
+    uint64_t head = __atomic_load_n(&meta->data_head, __ATOMIC_ACQUIRE);
+    uint64_t tail = meta->data_tail;
+
+    while (tail + sizeof(perf_event_header) <= head) {
+        perf_event_header header;
+        copyOut(&header, tail, sizeof(header));
+        if (header.size == 0)
+            break;
+
+        if (header.type == PERF_RECORD_SAMPLE) {
+            uint64_t ip;
+            copyOut(&ip, tail + sizeof(header), sizeof(ip));
+            ++_samples[ip];
+            ++_sampleCount;
+        }
+        else if (header.type == PERF_RECORD_LOST) {
+            uint64_t lost[2]; // id, lost
+            copyOut(lost, tail + sizeof(header), sizeof(lost));
+            _lostCount += lost[1];
+        }
+
+        tail += header.size;
+    }
+
+    __atomic_store_n(&meta->data_tail, tail, __ATOMIC_RELEASE);
+}
+
+void Profiler::clear()
+{
+    _samples.clear();
+    _sampleCount = 0;
+    _lostCount = 0;
+}
+
+QString Profiler::report(const QString &soFile, const QString &cxxFile, int maxEntries)
+{
+    const QString soPath = QFileInfo(soFile).canonicalFilePath();
+
+    QHash<uint64_t, uint64_t> moduleOffsets;
+    QHash<QString, uint64_t> outsideSymbols;
+    uint64_t moduleCount = 0;
+
+    for (const auto &sample : _samples) {
+        Dl_info info;
+        if (dladdr((void *)sample.first, &info) && info.dli_fname &&
+            QFileInfo(QString::fromUtf8(info.dli_fname)).canonicalFilePath() == soPath)
+        {
+            moduleOffsets[sample.first - (uint64_t)info.dli_fbase] += sample.second;
+            moduleCount += sample.second;
+        }
+        else if (dladdr((void *)sample.first, &info) && info.dli_sname)
+            outsideSymbols[QString::fromUtf8(info.dli_sname)] += sample.second;
+        else
+            outsideSymbols[QStringLiteral("[unknown]")] += sample.second;
+    }
+
+    if (_symbolFile != soFile) {
+        _symbolFile = soFile;
+        _symbols.clear();
+    }
+
+    QVector<uint64_t> unresolved;
+    for (auto it = moduleOffsets.begin(); it != moduleOffsets.end(); ++it) {
+        if (!_symbols.contains(it.key()))
+            unresolved.push_back(it.key());
+    }
+    if (!unresolved.isEmpty())
+        symbolize(soFile, unresolved);
+
+    ///
+    QStringList sourceLines;
+    {
+        QFile file(cxxFile);
+        if (file.open(QFile::ReadOnly)) {
+            QTextStream stream(&file);
+            while (!stream.atEnd())
+                sourceLines.push_back(stream.readLine().trimmed());
+        }
+    }
+
+    QMap<QPair<QString, int>, uint64_t> lineCounts;
+    QHash<QString, uint64_t> functionCounts;
+    for (auto it = moduleOffsets.begin(); it != moduleOffsets.end(); ++it) {
+        const Symbol &sym = _symbols[it.key()];
+        lineCounts[qMakePair(sym.file, sym.line)] += it.value();
+        functionCounts[sym.function] += it.value();
+    }
+
+    typedef QPair<uint64_t, QPair<QString, int>> LineEntry;
+    QVector<LineEntry> lines;
+    for (auto it = lineCounts.begin(); it != lineCounts.end(); ++it)
+        lines.push_back(qMakePair(it.value(), it.key()));
+    std::sort(lines.begin(), lines.end(), [](const LineEntry &a, const LineEntry &b) { return a.first > b.first; });
+
+    typedef QPair<uint64_t, QString> NameEntry;
+    QVector<NameEntry> functions;
+    for (auto it = functionCounts.begin(); it != functionCounts.end(); ++it)
+        functions.push_back(qMakePair(it.value(), it.key()));
+    for (auto it = outsideSymbols.begin(); it != outsideSymbols.end(); ++it)
+        functions.push_back(qMakePair(it.value(), QString("[host] %1").arg(it.key())));
+    std::sort(functions.begin(), functions.end(), [](const NameEntry &a, const NameEntry &b) { return a.first > b.first; });
+
+    ///
+    QString text;
+    QTextStream out(&text);
+
+    uint64_t total = _sampleCount;
+    auto percent = [total](uint64_t count) -> QString {
+        return QString("%1%").arg(total ? (100.0 * count / total) : 0.0, 6, 'f', 2);
+    };
+
+    out << "Samples: " << total << ", in module: " << moduleCount;
+    if (_lostCount > 0)
+        out << ", lost: " << _lostCount;
+    out << "\n\n";
+
+    out << "Functions\n";
+    for (int i = 0, n = std::min(maxEntries, functions.size()); i < n; ++i)
+        out << percent(functions[i].first) << "  " << functions[i].second << "\n";
+
+    out << "\nLines\n";
+    for (int i = 0, n = std::min(maxEntries, lines.size()); i < n; ++i) {
+        const QString &file = lines[i].second.first;
+        int line = lines[i].second.second;
+        out << percent(lines[i].first) << "  "
+            << QString("%1:%2").arg(QFileInfo(file).fileName()).arg(line).leftJustified(20);
+        if (line > 0 && line <= sourceLines.size())
+            out << "  " << sourceLines[line - 1];
+        out << "\n";
+    }
+
+    out.flush();
+    return text;
+}
+
+void Profiler::symbolize(const QString &soFile, const QVector<uint64_t> &offsets)
+{
+    QProcess proc;
+    proc.setProgram(getAddr2LineProgram());
+    QStringList args;
+    args << "-f" << "-C" << "-e" << soFile;
+    for (uint64_t offset : offsets)
+        args << QString("0x%1").arg(offset, 0, 16);
+    proc.setArguments(args);
+    proc.start();
+    proc.waitForFinished(-1);
+
+    QStringList output;
+    if (proc.exitStatus() == QProcess::NormalExit && proc.exitCode() == 0)
+        output = QString::fromUtf8(proc.readAllStandardOutput()).split('\n');
+    else
+        Log::w("Cannot symbolize the samples (addr2line)");
+
+    // two lines per address: function, then file:line
+    for (int i = 0, n = offsets.size(); i < n; ++i) {
+        Symbol sym;
+        sym.function = output.value(2 * i, "??");
+        QString location = output.value(2 * i + 1, "??:0");
+        location = location.section(' ', 0, 0);
+        int colon = location.lastIndexOf(':');
+        sym.file = location.left(colon);
+        sym.line = location.mid(colon + 1).toInt();
+        _symbols[offsets[i]] = sym;
+    }
+}
+
+} // namespace jest
@@ -0,0 +1,50 @@
+#pragma once
+#include <QString>
+#include <QMap>
+#include <QVector>
+#include <unordered_map>
+#include <cstdint>
+
+namespace jest {
+
+// Statistical profiler of a thread of this process, based on instruction
+// pointer samples from perf_event, and symbolized against a loaded module.
+class Profiler {
+public:
+    Profiler();
+    ~Profiler();
+
+    bool start(int threadId, unsigned frequency = 4000);
+    void stop();
+    bool isRunning() const noexcept { return _fd != -1; }
+    int getThreadId() const noexcept { return _threadId; }
+
+    void collect();
+    void clear();
+    uint64_t getSampleCount() const noexcept { return _sampleCount; }
+
+    QString report(const QString &soFile, const QString &cxxFile, int maxEntries = 30);
+
+private:
+    struct Symbol {
+        QString function;
+        QString file;
+        int line = 0;
+    };
+
+    void symbolize(const QString &soFile, const QVector<uint64_t> &offsets);
+
+private:
+    int _fd = -1;
+    int _threadId = -1;
+    void *_ring = nullptr;
+    size_t _ringSize = 0;
+    uint64_t _sampleCount = 0;
+    uint64_t _lostCount = 0;
+    std::unordered_map<uint64_t, uint64_t> _samples;
+
+    QString _symbolFile;
+    QMap<uint64_t, Symbol> _symbols;
+};
+
+} // namespace jest
@@ -0,0 +1,185 @@
+#include "jest_render.h"
+#include <algorithm>
+#include <random>
+#include <limits>
+#include <cmath>
+#include <ctime>
+
+namespace jest {
+
+bool testSignalFromName(const std::string &name, TestSignal *signal)
+{
+    if (name == "noise")
+        *signal = kSignalNoise;
+    else if (name == "sine")
+        *signal = kSignalSine;
+    else if (name == "impulse")
+        *signal = kSignalImpulse;
+    else if (name == "silence")
+        *signal = kSignalSilence;
+    else
+        return false;
+    return true;
+}
+
+std::vector<float> generateTestSignal(TestSignal signal, unsigned sampleRate, size_t length)
+{
+    std::vector<float> data(length);
+
+    switch (signal) {
+    case kSignalNoise: {
+        std::minstd_rand prng;
+        std::uniform_real_distribution<float> dist(-0.5f, 0.5f);
+        for (size_t i = 0; i < length; ++i)
+            data[i] = dist(prng);
+        break;
+    }
+    case kSignalSine: {
+        const double frequency = 440.0;
+        for (size_t i = 0; i < length; ++i)
+            data[i] = (float)(0.5 * std::sin(2 * M_PI * frequency * i / sampleRate));
+        break;
+    }
+    case kSignalImpulse:
+        // one impulse per second
+        for (size_t i = 0; i < length; i += sampleRate)
+            data[i] = 1.0f;
+        break;
+    case kSignalSilence:
+        break;
+    }
+
+    return data;
+}
+
+void RenderBuffers::resize(unsigned numInputs, unsigned numOutputs, unsigned blockSize)
+{
+    _inputs.resize(numInputs);
+    _outputs.resize(numOutputs);
+    _inputPointers.resize(numInputs);
+    _outputPointers.resize(numOutputs);
+    for (unsigned i = 0; i < numInputs; ++i) {
+        _inputs[i].resize(blockSize);
+        _inputPointers[i] = _inputs[i].data();
+    }
+    for (unsigned i = 0; i < numOutputs; ++i) {
+        _outputs[i].resize(blockSize);
+        _outputPointers[i] = _outputs[i].data();
+    }
+}
+
+void RenderBuffers::fillInputs(const float *signal, unsigned count)
+{
+    for (std::vector<FAUSTFLOAT> &input : _inputs)
+        std::copy(signal, signal + count, input.begin());
+}
+
+TimingStats computeTimingStats(std::vector<double> values)
+{
+    TimingStats stats;
+    size_t count = values.size();
+    if (count == 0)
+        return stats;
+
+    std::sort(values.begin(), values.end());
+    stats.min = values.front();
+    stats.max = values.back();
+    stats.p99 = values[std::min(count - 1, (size_t)(0.99 * count))];
+
+    double sum = 0;
+    for (double value : values)
+        sum += value;
+    stats.mean = sum / count;
+
+    double sum2 = 0;
+    for (double value : values)
+        sum2 += (value - stats.mean) * (value - stats.mean);
+    stats.stddev = std::sqrt(sum2 / count);
+
+    return stats;
+}
+
+uint64_t monotonicTime() noexcept
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+std::vector<double> measureBlockTimes(dsp *dsp, const std::vector<float> &signal, unsigned blockSize, size_t skipBlocks)
+{
+    RenderBuffers buffers;
+    buffers.resize(dsp->getNumInputs(), dsp->getNumOutputs(), blockSize);
+
+    size_t numBlocks = signal.size() / blockSize;
+    std::vector<double> times;
+    times.reserve(numBlocks);
+
+    for (size_t block = 0; block < numBlocks; ++block) {
+        buffers.fillInputs(&signal[block * blockSize], blockSize);
+        uint64_t start = monotonicTime();
+        dsp->compute((int)blockSize, buffers.inputs(), buffers.outputs());
+        uint64_t end = monotonicTime();
+        if (block >= skipBlocks)
+            times.push_back((double)(end - start) / blockSize);
+    }
+
+    return times;
+}
+
+std::vector<std::vector<float>> renderSignal(dsp *dsp, const std::vector<float> &signal, unsigned blockSize)
+{
+    unsigned numOutputs = dsp->getNumOutputs();
+    RenderBuffers buffers;
+    buffers.resize(dsp->getNumInputs(), numOutputs, blockSize);
+
+    size_t length = signal.size();
+    std::vector<std::vector<float>> outputs(numOutputs, std::vector<float>(length));
+
+    for (size_t offset = 0; offset < length; offset += blockSize) {
+        unsigned count = (unsigned)std::min<size_t>(blockSize, length - offset);
+        buffers.fillInputs(&signal[offset], count);
+        dsp->compute((int)count, buffers.inputs(), buffers.outputs());
+        for (unsigned i = 0; i < numOutputs; ++i)
+            std::copy(buffers.outputs()[i], buffers.outputs()[i] + count, &outputs[i][offset]);
+    }
+
+    return outputs;
+}
+
+void RenderError::add(const RenderError &other)
+{
+    maxError = std::max(maxError, other.maxError);
+    errorEnergy += other.errorEnergy;
+    referenceEnergy += other.referenceEnergy;
+    count += other.count;
+}
+
+double RenderError::rmsError() const
+{
+    return count ? std::sqrt(errorEnergy / count) : 0.0;
+}
+
+double RenderError::snr() const
+{
+    if (errorEnergy == 0)
+        return std::numeric_limits<double>::infinity();
+    return 10 * std::log10(referenceEnergy / errorEnergy);
+}
+
+RenderError compareRenders(const std::vector<float> &reference, const std::vector<float> &test)
+{
+    RenderError error;
+    size_t length = std::min(reference.size(), test.size());
+    for (size_t i = 0; i < length; ++i) {
+        double ref = reference[i];
+        double diff = (double)test[i] - ref;
+        error.maxError = std::max(error.maxError, std::fabs(diff));
+        error.errorEnergy += diff * diff;
+        error.referenceEnergy += ref * ref;
+    }
+    error.count = length;
+    return error;
+}
+
+} // namespace jest
@@ -0,0 +1,69 @@
+#pragma once
+#include <faust/dsp/dsp.h>
+#include <vector>
+#include <string>
+#include <cstdint>
+
+namespace jest {
+
+enum TestSignal {
+    kSignalNoise,
+    kSignalSine,
+    kSignalImpulse,
+    kSignalSilence,
+};
+
+bool testSignalFromName(const std::string &name, TestSignal *signal);
+std::vector<float> generateTestSignal(TestSignal signal, unsigned sampleRate, size_t length);
+
+// I/O buffers of a DSP, processed by blocks
+class RenderBuffers {
+public:
+    void resize(unsigned numInputs, unsigned numOutputs, unsigned blockSize);
+    void fillInputs(const float *signal, unsigned count);
+    FAUSTFLOAT **inputs() noexcept { return _inputPointers.data(); }
+    FAUSTFLOAT **outputs() noexcept { return _outputPointers.data(); }
+    unsigned numInputs() const noexcept { return (unsigned)_inputs.size(); }
+    unsigned numOutputs() const noexcept { return (unsigned)_outputs.size(); }
+
+private:
+    std::vector<std::vector<FAUSTFLOAT>> _inputs;
+    std::vector<std::vector<FAUSTFLOAT>> _outputs;
+    std::vector<FAUSTFLOAT *> _inputPointers;
+    std::vector<FAUSTFLOAT *> _outputPointers;
+};
+
+struct TimingStats {
+    double mean = 0;
+    double stddev = 0;
+    double min = 0;
+    double max = 0;
+    double p99 = 0;
+};
+
+TimingStats computeTimingStats(std::vector<double> values);
+
+uint64_t monotonicTime() noexcept;
+
+// the compute time of each block, in nanoseconds per sample
+std::vector<double> measureBlockTimes(dsp *dsp, const std::vector<float> &signal, unsigned blockSize, size_t skipBlocks);
+
+// the output channels, of the same length as the signal
+std::vector<std::vector<float>> renderSignal(dsp *dsp, const std::vector<float> &signal, unsigned blockSize);
+
+// the difference of a render to a reference render
+struct RenderError {
+    double maxError = 0;
+    double errorEnergy = 0;
+    double referenceEnergy = 0;
+    size_t count = 0;
+
+    void add(const RenderError &other);
+    double rmsError() const;
+    // signal to error ratio in dB, infinite if the renders are identical
+    double snr() const;
+};
+
+RenderError compareRenders(const std::vector<float> &reference, const std::vector<float> &test);
+
+} // namespace jest
@@ -0,0 +1,71 @@
+#include "jest_report_panel.h"
+#include <QTabWidget>
+#include <QPlainTextEdit>
+#include <QFontDatabase>
+#include <QScrollBar>
+
+namespace jest {
+
+struct ReportPanel::Impl {
+    QTabWidget *_tabs = nullptr;
+
+    QPlainTextEdit *findReport(const QString &title) const;
+};
+
+ReportPanel::ReportPanel()
+    : _impl(new Impl)
+{
+    Impl &impl = *_impl;
+
+    setFeatures(QDockWidget::NoDockWidgetFeatures);
+    setWindowTitle(tr("Reports"));
+
+    QTabWidget *tabs = new QTabWidget;
+    impl._tabs = tabs;
+    setWidget(tabs);
+}
+
+ReportPanel::~ReportPanel()
+{
+}
+
+void ReportPanel::setReport(const QString &title, const QString &text)
+{
+    Impl &impl = *_impl;
+
+    QPlainTextEdit *edit = impl.findReport(title);
+    if (!edit) {
+        edit = new QPlainTextEdit;
+        edit->setReadOnly(true);
+        edit->setLineWrapMode(QPlainTextEdit::NoWrap);
+        edit->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+        edit->setMinimumSize(480, 240);
+        impl._tabs->addTab(edit, title);
+    }
+
+    // keep the reading position across refreshes
+    int scroll = edit->verticalScrollBar()->value();
+    edit->setPlainText(text);
+    edit->verticalScrollBar()->setValue(scroll);
+}
+
+void ReportPanel::removeReport(const QString &title)
+{
+    Impl &impl = *_impl;
+
+    if (QPlainTextEdit *edit = impl.findReport(title)) {
+        impl._tabs->removeTab(impl._tabs->indexOf(edit));
+        delete edit;
+    }
+}
+
+QPlainTextEdit *ReportPanel::Impl::findReport(const QString &title) const
+{
+    for (int i = 0, n = _tabs->count(); i < n; ++i) {
+        if (_tabs->tabText(i) == title)
+            return static_cast<QPlainTextEdit *>(_tabs->widget(i));
+    }
+    return nullptr;
+}
+
+} // namespace jest
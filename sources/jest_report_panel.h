@@ -0,0 +1,22 @@
+#pragma once
+#include <QDockWidget>
+#include <memory>
+
+namespace jest {
+
+class ReportPanel : public QDockWidget {
+    Q_OBJECT
+
+public:
+    ReportPanel();
+    ~ReportPanel();
+
+    void setReport(const QString &title, const QString &text);
+    void removeReport(const QString &title);
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> _impl;
+};
+
+} // namespace jest
@@ -0,0 +1,155 @@
+#include "jest_shared_cache.h"
+#include "utility/logs.h"
+#include <QStandardPaths>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QDateTime>
+#include <sys/file.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <utime.h>
+#include <cerrno>
+
+namespace jest {
+
+enum {
+    kSharedCacheMaxAgeDays = 30,
+    // the copies in progress are younger, the older ones were left by a crash
+    kSharedCacheTempMaxAgeDays = 1,
+};
+
+static int lockFile(const QString &fileName, bool wait)
+{
+    int fd = open(fileName.toUtf8().constData(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd == -1)
+        return -1;
+
+    int ret;
+    while ((ret = flock(fd, LOCK_EX | (wait ? 0 : LOCK_NB))) == -1 && errno == EINTR);
+    if (ret == -1) {
+        int error = errno;
+        close(fd);
+        errno = error;
+        return -1;
+    }
+    return fd;
+}
+
+// copies under a temporary name first, so a partial file is never visible
+static bool copyAtomically(const QString &source, const QString &destination)
+{
+    const QString tempFile = destination + QString(".%1.tmp").arg(getpid());
+    QFile::remove(tempFile);
+    if (!QFile::copy(source, tempFile))
+        return false;
+    if (rename(tempFile.toUtf8().constData(), destination.toUtf8().constData()) == -1) {
+        QFile::remove(tempFile);
+        return false;
+    }
+    return true;
+}
+
+SharedCacheEntry::SharedCacheEntry(const QString &key)
+{
+    const QString &dir = getDirectory();
+    if (dir.isEmpty())
+        return;
+
+    _path = QString("%1/%2").arg(dir).arg(key);
+    const QString lock = _path + ".lock";
+
+    _fd = lockFile(lock, false);
+    if (_fd == -1 && errno == EWOULDBLOCK) {
+        Log::i("Waiting for another process building the same module");
+        _fd = lockFile(lock, true);
+    }
+    if (_fd == -1)
+        Log::w("Cannot lock the shared cache entry");
+}
+
+SharedCacheEntry::~SharedCacheEntry()
+{
+    if (_fd != -1)
+        close(_fd);
+}
+
+bool SharedCacheEntry::exists() const
+{
+    const QByteArray soFile = getSoFile().toUtf8();
+    if (access(soFile.constData(), R_OK) != 0)
+        return false;
+    // keeps the entry from being pruned
+    utime(soFile.constData(), nullptr);
+    return true;
+}
+
+bool SharedCacheEntry::store(const QString &soFile, const QString &cxxFile)
+{
+    if (!cxxFile.isEmpty() && !copyAtomically(cxxFile, getCxxFile()))
+        return false;
+    // the module goes last, its presence means the entry is complete
+    if (!copyAtomically(soFile, getSoFile())) {
+        Log::w("Cannot store the module in the shared cache");
+        return false;
+    }
+    return true;
+}
+
+const QString &SharedCacheEntry::getDirectory()
+{
+    static QString dir = []() -> QString {
+        const QByteArray data = qgetenv("JEST_SHARED_CACHE");
+        if (data == "off")
+            return QString();
+        QString dir = QString::fromUtf8(data);
+        if (dir.isEmpty()) {
+            const QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+            dir = QString("%1/modules").arg(cacheDir);
+        }
+        if (!QDir(dir).mkpath(".")) {
+            Log::w("Cannot create the shared cache directory");
+            return QString();
+        }
+        return dir;
+    }();
+    return dir;
+}
+
+void SharedCacheEntry::prune()
+{
+    const QString &dir = getDirectory();
+    if (dir.isEmpty())
+        return;
+
+    const QDateTime now = QDateTime::currentDateTime();
+    const QDateTime limit = now.addDays(-kSharedCacheMaxAgeDays);
+    const QDateTime tempLimit = now.addDays(-kSharedCacheTempMaxAgeDays);
+    const QDir cacheDir(dir);
+
+    for (const QFileInfo &info : cacheDir.entryInfoList(QStringList() << "*.tmp", QDir::Files)) {
+        if (info.fileTime(QFile::FileModificationTime) < tempLimit)
+            QFile::remove(info.absoluteFilePath());
+    }
+
+    // every entry has a lock, also the ones whose build has failed
+    for (const QFileInfo &info : cacheDir.entryInfoList(QStringList() << "*.lock", QDir::Files)) {
+        const QString path = info.absolutePath() + '/' + info.completeBaseName();
+        const QFileInfo soInfo(path + ".so");
+        const QFileInfo &used = soInfo.exists() ? soInfo : info;
+        if (used.fileTime(QFile::FileModificationTime) >= limit)
+            continue;
+        // skips the entries being built; processes which have the module mapped keep it
+        int fd = lockFile(info.absoluteFilePath(), false);
+        if (fd == -1)
+            continue;
+        QFile::remove(path + ".so");
+        QFile::remove(path + ".cpp");
+        // a process which opened the lock before it goes may build the entry
+        // again beside another, which only duplicates the work
+        QFile::remove(info.absoluteFilePath());
+        close(fd);
+    }
+}
+
+} // namespace jest
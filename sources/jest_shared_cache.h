@@ -0,0 +1,33 @@
+#pragma once
+#include <QString>
+
+namespace jest {
+
+// An entry of the module cache shared by all jest processes of the user.
+// The entry is locked for as long as the object lives, so that a module
+// is built once, while other processes wait to reuse it.
+class SharedCacheEntry {
+public:
+    explicit SharedCacheEntry(const QString &key);
+    ~SharedCacheEntry();
+
+    SharedCacheEntry(const SharedCacheEntry &) = delete;
+    SharedCacheEntry &operator=(const SharedCacheEntry &) = delete;
+
+    bool isLocked() const noexcept { return _fd != -1; }
+    bool exists() const;
+    QString getSoFile() const { return _path + ".so"; }
+    QString getCxxFile() const { return _path + ".cpp"; }
+    // copies the build results in, the generated code being optional
+    bool store(const QString &soFile, const QString &cxxFile);
+
+    // empty if the shared cache is disabled
+    static const QString &getDirectory();
+    static void prune();
+
+private:
+    QString _path;
+    int _fd = -1;
+};
+
+} // namespace jest
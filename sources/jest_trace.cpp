@@ -0,0 +1,147 @@
+#include "jest_trace.h"
+#include "utility/logs.h"
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+#include <ctime>
+#include <cstdio>
+
+namespace jest {
+
+struct TraceEvent {
+    std::atomic<bool> ready{false};
+    char phase = 0;
+    int tid = 0;
+    uint64_t time = 0;
+    const char *name = nullptr;
+};
+
+struct TraceBuffer {
+    std::string fileName;
+    std::unique_ptr<TraceEvent[]> events;
+    size_t capacity = 0;
+    std::atomic<size_t> count{0};
+};
+
+static std::atomic<TraceBuffer *> trace_buffer{nullptr};
+
+static uint64_t trace_clock() noexcept
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int trace_thread_id() noexcept
+{
+    static thread_local int tid = 0;
+    if (tid == 0)
+        tid = (int)syscall(SYS_gettid);
+    return tid;
+}
+
+bool Trace::open(const std::string &fileName, size_t capacity)
+{
+    close();
+
+    TraceBuffer *buffer = new TraceBuffer;
+    buffer->fileName = fileName;
+    buffer->events.reset(new TraceEvent[capacity]);
+    buffer->capacity = capacity;
+    trace_buffer.store(buffer, std::memory_order_release);
+
+    Log::i("Tracing into %s", fileName.c_str());
+    return true;
+}
+
+void Trace::close()
+{
+    TraceBuffer *buffer = trace_buffer.exchange(nullptr, std::memory_order_acq_rel);
+    if (!buffer)
+        return;
+
+    // recorders which loaded the buffer before the exchange may still be
+    // writing their event: these are skipped by the `ready` flag, and the
+    // buffer is never freed
+
+    FILE *stream = fopen(buffer->fileName.c_str(), "w");
+    if (!stream) {
+        Log::e("Cannot write the trace file %s", buffer->fileName.c_str());
+        return;
+    }
+
+    int pid = (int)getpid();
+    size_t count = std::min(buffer->count.load(std::memory_order_acquire), buffer->capacity);
+
+    fprintf(stream, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+    for (size_t i = 0; i < count; ++i) {
+        const TraceEvent &event = buffer->events[i];
+        if (!event.ready.load(std::memory_order_acquire))
+            continue;
+        fprintf(stream, "%s", first ? "" : ",\n");
+        first = false;
+        if (event.phase == 'M') {
+            fprintf(stream, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                    pid, event.tid, event.name);
+        }
+        else {
+            fprintf(stream, "{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d%s}",
+                    event.name, event.phase, 1e-3 * event.time, pid, event.tid,
+                    (event.phase == 'i') ? ",\"s\":\"p\"" : "");
+        }
+    }
+    fprintf(stream, "\n]}\n");
+    fclose(stream);
+
+    if (buffer->count.load() > buffer->capacity)
+        Log::w("Trace buffer overflow, %zu events lost", buffer->count.load() - buffer->capacity);
+    Log::s("Trace written to %s", buffer->fileName.c_str());
+}
+
+bool Trace::isEnabled() noexcept
+{
+    return trace_buffer.load(std::memory_order_relaxed) != nullptr;
+}
+
+void Trace::begin(const char *name) noexcept
+{
+    record(name, 'B');
+}
+
+void Trace::end(const char *name) noexcept
+{
+    record(name, 'E');
+}
+
+void Trace::instant(const char *name) noexcept
+{
+    record(name, 'i');
+}
+
+void Trace::setThreadName(const char *name) noexcept
+{
+    record(name, 'M');
+}
+
+void Trace::record(const char *name, char phase) noexcept
+{
+    TraceBuffer *buffer = trace_buffer.load(std::memory_order_acquire);
+    if (!buffer)
+        return;
+
+    size_t index = buffer->count.fetch_add(1, std::memory_order_relaxed);
+    if (index >= buffer->capacity)
+        return;
+
+    TraceEvent &event = buffer->events[index];
+    event.phase = phase;
+    event.tid = trace_thread_id();
+    event.time = trace_clock();
+    event.name = name;
+    event.ready.store(true, std::memory_order_release);
+}
+
+} // namespace jest
@@ -0,0 +1,35 @@
+#pragma once
+#include <string>
+#include <cstdint>
+
+namespace jest {
+
+// Recorder of timeline events, exported in the Chrome trace format.
+// Recording is lock-free and does not allocate; names must be literals.
+class Trace {
+public:
+    static bool open(const std::string &fileName, size_t capacity = 1 << 16);
+    static void close();
+    static bool isEnabled() noexcept;
+
+    static void begin(const char *name) noexcept;
+    static void end(const char *name) noexcept;
+    static void instant(const char *name) noexcept;
+    static void setThreadName(const char *name) noexcept;
+
+private:
+    static void record(const char *name, char phase) noexcept;
+};
+
+class TraceScope {
+public:
+    explicit TraceScope(const char *name) noexcept : _name(name) { Trace::begin(name); }
+    ~TraceScope() noexcept { Trace::end(_name); }
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+
+private:
+    const char *_name;
+};
+
+} // namespace jest
@@ -1,18 +1,30 @@
 #include "jest_worker.h"
+#include "jest_trace.h"
+#include <QThread>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
+#include <vector>
+#include <deque>
+#include <algorithm>
 
 namespace jest {
 
 struct Worker::Impl {
     Worker *_self = nullptr;
-    volatile bool _quit = false;
-    std::unique_ptr<CompileRequest> _req;
-    std::thread _thread;
+    bool _quit = false;
+    // only the latest interactive request matters, and one builds at a time
+    std::unique_ptr<CompileRequest> _interactive;
+    bool _interactiveRunning = false;
+    std::deque<CompileRequest> _queue;
+    unsigned _backgroundRunning = 0;
+    unsigned _backgroundMax = 0;
+    std::vector<std::thread> _threads;
     std::mutex _mutex;
     std::condition_variable _cond;
 
+    static unsigned getThreadCount();
+    std::unique_ptr<CompileRequest> takeRequest();
     void performWork();
 };
 
@@ -24,7 +36,11 @@ Worker::Worker(QObject *parent)
     Impl &impl = *_impl;
 
     impl._self = this;
-    impl._thread = std::thread([&impl]() { impl.performWork(); });
+    const unsigned threadCount = Impl::getThreadCount();
+    // one thread is always left for the interactive request
+    impl._backgroundMax = threadCount - 1;
+    for (unsigned i = 0; i < threadCount; ++i)
+        impl._threads.emplace_back([&impl]() { impl.performWork(); });
 
     connect(
         this, &Worker::startedCompilingPrivate,
@@ -40,9 +56,10 @@ Worker::~Worker()
 
     std::unique_lock<std::mutex> lock(impl._mutex);
     impl._quit = true;
-    impl._cond.notify_one();
+    impl._cond.notify_all();
     lock.unlock();
-    impl._thread.join();
+    for (std::thread &thread : impl._threads)
+        thread.join();
 }
 
 void Worker::request(const CompileRequest &request)
@@ -50,30 +67,87 @@ void Worker::request(const CompileRequest &request)
     Impl &impl = *_impl;
 
     std::unique_lock<std::mutex> lock(impl._mutex);
-    impl._req.reset(new CompileRequest(request));
-    impl._cond.notify_one();
+    if (request.priority == kCompilePriorityInteractive)
+        impl._interactive.reset(new CompileRequest(request));
+    else {
+        // after the requests of the same priority or higher
+        auto pos = std::find_if(
+            impl._queue.begin(), impl._queue.end(),
+            [&request](const CompileRequest &other) { return other.priority > request.priority; });
+        impl._queue.insert(pos, request);
+    }
+    impl._cond.notify_all();
     lock.unlock();
 }
 
+void Worker::cancel(int priority)
+{
+    Impl &impl = *_impl;
+
+    std::unique_lock<std::mutex> lock(impl._mutex);
+    impl._queue.erase(
+        std::remove_if(
+            impl._queue.begin(), impl._queue.end(),
+            [priority](const CompileRequest &other) { return other.priority >= priority; }),
+        impl._queue.end());
+}
+
 ///
-void Worker::Impl::performWork()
+unsigned Worker::Impl::getThreadCount()
 {
-    for (;;) {
-        std::unique_lock<std::mutex> lock(_mutex);
+    static unsigned count = []() -> unsigned {
+        // one for the interactive request, and at least one for the others
+        bool ok = false;
+        unsigned count = qgetenv("JEST_WORKER_THREADS").toUInt(&ok);
+        if (ok && count > 0)
+            return std::max(2u, count);
+        return (unsigned)std::max(2, QThread::idealThreadCount() / 2);
+    }();
+    return count;
+}
 
-        if (_quit)
-            break;
+std::unique_ptr<CompileRequest> Worker::Impl::takeRequest()
+{
+    if (_interactive && !_interactiveRunning) {
+        _interactiveRunning = true;
+        return std::move(_interactive);
+    }
 
-        if (!_req)
-            _cond.wait(lock);
+    if (!_queue.empty() && _backgroundRunning < _backgroundMax) {
+        ++_backgroundRunning;
+        std::unique_ptr<CompileRequest> req(new CompileRequest(std::move(_queue.front())));
+        _queue.pop_front();
+        return req;
+    }
+
+    return nullptr;
+}
 
+void Worker::Impl::performWork()
+{
+    // names are kept by pointer, the threads are told apart by their id
+    Trace::setThreadName("worker");
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    for (;;) {
+        std::unique_ptr<CompileRequest> req;
+        while (!_quit && !(req = takeRequest()))
+            _cond.wait(lock);
         if (_quit)
             break;
 
-        std::unique_ptr<CompileRequest> req = std::move(_req);
+        lock.unlock();
         emit _self->startedCompilingPrivate(*req);
         CompileResult result = DSPWrapper::compile(*req);
         emit _self->finishedCompilingPrivate(*req, result);
+        lock.lock();
+
+        if (req->priority == kCompilePriorityInteractive)
+            _interactiveRunning = false;
+        else
+            --_backgroundRunning;
+        // a request may have been waiting for this thread to be done
+        _cond.notify_all();
     }
 }
 
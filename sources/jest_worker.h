@@ -13,6 +13,8 @@ public:
     ~Worker();
 
     void request(const CompileRequest &request);
+    // drops the queued requests of this priority and lower
+    void cancel(int priority);
 
 signals:
     void startedCompiling(const CompileRequest &request);
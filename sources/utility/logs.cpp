@@ -4,13 +4,281 @@
 //          http://www.boost.org/LICENSE_1_0.txt)
 
 #include "logs.h"
-#include <sys/time.h>
-#include <system_error>
+#include <thread>
 #include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
 #include <cstdio>
 #include <cstdlib>
+#include <cstdint>
 #include <ctime>
 
+namespace {
+
+enum {
+    kLogInfo,
+    kLogWarning,
+    kLogError,
+    kLogSuccess,
+};
+
+struct LogLevel {
+    char symbol;
+    const char *tag;
+    const char *color;
+};
+
+const LogLevel log_levels[] = {
+    {'-', "info", "\033[36m"},
+    {'!', "warn", "\033[33m"},
+    {'x', "error", "\033[31m"},
+    {'*', "success", "\033[32m"},
+};
+
+enum {
+    kLogQueueSize = 1024, // power of 2
+    kLogMessageSize = 256,
+    kLogRateLimit = 1000, // lines per second
+};
+
+struct LogRecord {
+    uint64_t time;
+    int level;
+    char text[kLogMessageSize];
+};
+
+uint64_t clock_ns(clockid_t id)
+{
+    timespec ts;
+    clock_gettime(id, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// bounded multi-producer multi-consumer queue (D. Vyukov)
+class LogQueue {
+public:
+    LogQueue()
+    {
+        for (size_t i = 0; i < kLogQueueSize; ++i)
+            _cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    bool push(int level, uint64_t time, const char *format, va_list ap)
+    {
+        size_t pos = _pushPos.load(std::memory_order_relaxed);
+        Cell *cell;
+        for (;;) {
+            cell = &_cells[pos & (kLogQueueSize - 1)];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+            if (diff == 0) {
+                if (_pushPos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+                return false;
+            else
+                pos = _pushPos.load(std::memory_order_relaxed);
+        }
+
+        LogRecord &record = cell->record;
+        record.time = time;
+        record.level = level;
+        vsnprintf(record.text, sizeof(record.text), format, ap);
+
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(LogRecord &record)
+    {
+        size_t pos = _popPos.load(std::memory_order_relaxed);
+        Cell *cell;
+        for (;;) {
+            cell = &_cells[pos & (kLogQueueSize - 1)];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+            if (diff == 0) {
+                if (_popPos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+                return false;
+            else
+                pos = _popPos.load(std::memory_order_relaxed);
+        }
+
+        record = cell->record;
+        cell->sequence.store(pos + kLogQueueSize, std::memory_order_release);
+        return true;
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        LogRecord record;
+    };
+
+    Cell _cells[kLogQueueSize];
+    alignas(64) std::atomic<size_t> _pushPos{0};
+    alignas(64) std::atomic<size_t> _popPos{0};
+};
+
+class Logger {
+public:
+    Logger();
+    ~Logger();
+
+    void post(int level, bool blocking, const char *format, va_list ap);
+    void flush();
+
+private:
+    void drain();
+    void write(const LogRecord &record);
+
+private:
+    LogQueue _queue;
+    uint64_t _realtimeOffset = 0;
+    std::atomic<uint64_t> _posted{0};
+    std::atomic<uint64_t> _dropped{0};
+    uint64_t _written = 0;
+    uint64_t _rateWindow = 0;
+    unsigned _rateCount = 0;
+    unsigned _rateSuppressed = 0;
+    bool _quit = false;
+    std::mutex _mutex;
+    std::condition_variable _cond;
+    std::condition_variable _flushCond;
+    std::thread _thread;
+};
+
+Logger::Logger()
+{
+    _realtimeOffset = clock_ns(CLOCK_REALTIME) - clock_ns(CLOCK_MONOTONIC);
+    _thread = std::thread([this]() { drain(); });
+}
+
+Logger::~Logger()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _quit = true;
+    _cond.notify_one();
+    lock.unlock();
+    _thread.join();
+}
+
+void Logger::post(int level, bool blocking, const char *format, va_list ap)
+{
+    uint64_t time = clock_ns(CLOCK_MONOTONIC);
+
+    bool pushed;
+    if (!blocking)
+        pushed = _queue.push(level, time, format, ap);
+    else {
+        for (;;) {
+            va_list aq;
+            va_copy(aq, ap);
+            pushed = _queue.push(level, time, format, aq);
+            va_end(aq);
+            if (pushed)
+                break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    if (!pushed) {
+        _dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    _posted.fetch_add(1, std::memory_order_release);
+
+    // real-time threads rely on the periodic wakeup of the drain thread
+    if (blocking)
+        _cond.notify_one();
+}
+
+void Logger::flush()
+{
+    uint64_t target = _posted.load(std::memory_order_acquire);
+    std::unique_lock<std::mutex> lock(_mutex);
+    _cond.notify_one();
+    _flushCond.wait(lock, [this, target]() { return _written >= target || _quit; });
+}
+
+void Logger::drain()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    for (;;) {
+        LogRecord record;
+        bool any = false;
+        while (_queue.pop(record)) {
+            write(record);
+            ++_written;
+            any = true;
+        }
+
+        uint64_t dropped = _dropped.exchange(0, std::memory_order_relaxed);
+        if (dropped > 0) {
+            fprintf(stderr, "[log] %llu messages dropped\n", (unsigned long long)dropped);
+            any = true;
+        }
+
+        if (any)
+            fflush(stderr);
+        _flushCond.notify_all();
+
+        if (_quit && _written >= _posted.load(std::memory_order_acquire)) {
+            if (_rateSuppressed > 0)
+                fprintf(stderr, "[log] %u messages suppressed\n", _rateSuppressed);
+            break;
+        }
+
+        _cond.wait_for(lock, std::chrono::milliseconds(20));
+    }
+}
+
+void Logger::write(const LogRecord &record)
+{
+    uint64_t time = record.time + _realtimeOffset;
+
+    uint64_t window = time / 1000000000;
+    if (window != _rateWindow) {
+        if (_rateSuppressed > 0)
+            fprintf(stderr, "[log] %u messages suppressed\n", _rateSuppressed);
+        _rateWindow = window;
+        _rateCount = 0;
+        _rateSuppressed = 0;
+    }
+    // errors are never suppressed
+    if (record.level != kLogError && ++_rateCount > (unsigned)kLogRateLimit) {
+        ++_rateSuppressed;
+        return;
+    }
+
+    time_t ts = (time_t)window;
+    tm tm;
+    char timebuf[64];
+    if (localtime_r(&ts, &tm))
+        strftime(timebuf, sizeof(timebuf), "%X", &tm);
+    else
+        snprintf(timebuf, sizeof(timebuf), "%llu", (unsigned long long)window);
+
+    const LogLevel &level = log_levels[record.level];
+    fprintf(stderr, "%s.%03u [%c] %-8s %s%s%s\n",
+            timebuf, (unsigned)(time / 1000000 % 1000), level.symbol, level.tag,
+            level.color, record.text, "\033[0m");
+}
+
+Logger &getLogger()
+{
+    static Logger logger;
+    return logger;
+}
+
+} // namespace
+
 void Log::i(const char *format, ...)
 {
     va_list ap;
@@ -45,58 +313,74 @@ void Log::s(const char *format, ...)
 
 void Log::vi(const char *format, va_list ap)
 {
-    generic('-', "info", "\033[36m", format, ap);
+    generic(kLogInfo, true, format, ap);
 }
 
 void Log::vw(const char *format, va_list ap)
 {
-    generic('!', "warn", "\033[33m", format, ap);
+    generic(kLogWarning, true, format, ap);
 }
 
 void Log::ve(const char *format, va_list ap)
 {
-    generic('x', "error", "\033[31m", format, ap);
+    generic(kLogError, true, format, ap);
 }
 
 void Log::vs(const char *format, va_list ap)
 {
-    generic('*', "success", "\033[32m", format, ap);
+    generic(kLogSuccess, true, format, ap);
 }
 
-void Log::generic(char symbol, const char *tag, const char *color, const char *format, va_list ap)
+void Log::flush()
 {
-    static std::mutex mutex;
-    std::lock_guard<std::mutex> lock(mutex);
+    getLogger().flush();
+}
 
-    timeval tv;
-    tm tm;
-    if (gettimeofday(&tv, nullptr) == -1)
-        throw std::system_error(errno, std::generic_category());
-
-    time_t ts = tv.tv_sec;
-#if !defined(_WIN32)
-    if (!localtime_r(&ts, &tm))
-        throw std::system_error(errno, std::generic_category());
-#else
-    errno_t localtime_errno = localtime_s(&tm, &ts);
-    if (localtime_errno != 0)
-        throw std::system_error(localtime_errno, std::generic_category());
-#endif
+void Log::generic(int level, bool blocking, const char *format, va_list ap)
+{
+    getLogger().post(level, blocking, format, ap);
+}
 
-    char timebuf[64];
-    strftime(timebuf, sizeof(timebuf), "%X", &tm);
+///
+void RTLog::i(const char *format, ...)
+{
+    va_list ap;
+    va_start(ap, format);
+    Log::generic(kLogInfo, false, format, ap);
+    va_end(ap);
+}
+
+void RTLog::w(const char *format, ...)
+{
+    va_list ap;
+    va_start(ap, format);
+    Log::generic(kLogWarning, false, format, ap);
+    va_end(ap);
+}
 
-    fprintf(stderr, "%s.%03d [%c] %-8s %s", timebuf, (unsigned)tv.tv_usec / 1000 % 1000, symbol, tag, color);
-    vfprintf(stderr, format, ap);
-    fprintf(stderr, "%s\n", "\033[0m");
-    fflush(stderr);
+void RTLog::e(const char *format, ...)
+{
+    va_list ap;
+    va_start(ap, format);
+    Log::generic(kLogError, false, format, ap);
+    va_end(ap);
+}
+
+void RTLog::s(const char *format, ...)
+{
+    va_list ap;
+    va_start(ap, format);
+    Log::generic(kLogSuccess, false, format, ap);
+    va_end(ap);
 }
 
+///
 void panic(const char *format, ...)
 {
     va_list ap;
     va_start(ap, format);
     Log::ve(format, ap);
     va_end(ap);
+    Log::flush();
     exit(1);
 }
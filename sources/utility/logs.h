@@ -12,6 +12,8 @@
     #define PRINTF_ATTR(a, b)
 #endif
 
+// Messages are formatted by the caller into a lock-free queue, and written
+// out asynchronously by a background thread.
 class Log {
 public:
     static void i(const char *format, ...) PRINTF_ATTR(1, 2);
@@ -24,8 +26,21 @@ public:
     static void ve(const char *format, va_list ap);
     static void vs(const char *format, va_list ap);
 
+    static void flush();
+
 private:
-    static void generic(char symbol, const char *tag, const char *color, const char *format, va_list ap);
+    friend class RTLog;
+    static void generic(int level, bool blocking, const char *format, va_list ap);
+};
+
+// Non-blocking variant for real-time threads: the message is dropped if the
+// queue is full.
+class RTLog {
+public:
+    static void i(const char *format, ...) PRINTF_ATTR(1, 2);
+    static void w(const char *format, ...) PRINTF_ATTR(1, 2);
+    static void e(const char *format, ...) PRINTF_ATTR(1, 2);
+    static void s(const char *format, ...) PRINTF_ATTR(1, 2);
 };
 
 void panic(const char *format, ...) PRINTF_ATTR(1, 2);